@@ -9,6 +9,6 @@ public class BetterPortalsTarget : TargetRules
 	{
 		Type = TargetType.Game;
 
-		ExtraModuleNames.AddRange( new string[] { "BetterPortals" } );
+		ExtraModuleNames.AddRange( new string[] { "BetterPortals", "PortalShaders" } );
 	}
 }
@@ -2,11 +2,8 @@
 #include "BetterPortalsGameModeBase.h"
 #include "Engine/Engine.h"
 #include "Engine/World.h"
-#include "EngineUtils.h"
-#include "TimerManager.h"
+#include "PortalManager.h"
 #include "GameFramework/Actor.h"
-#include "PortalPawn.h"
-#include "Camera/CameraComponent.h"
 
 DEFINE_LOG_CATEGORY(LogPortalGamemode);
 
@@ -18,6 +15,7 @@ ABetterPortalsGameModeBase::ABetterPortalsGameModeBase()
 	// Defaults.
 	performantPortals = true;
 	checkDirection = false;
+	portalUpdateDistance = 50.0f;
 	portalUpdateRate = 0.1f;
 	maxPortalRenderDistance = 500.0f;
 }
@@ -26,65 +24,26 @@ void ABetterPortalsGameModeBase::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Save reference to the player and all portals in the scene.
-	APlayerController* PC = GetWorld()->GetFirstPlayerController();
-	CHECK_DESTROY(LogPortalGamemode, !PC, "Player controller could not be found in the gamemode class %s.", *GetName());
-	APortalPawn* foundPawn = Cast<APortalPawn>(PC->GetPawn());
-	CHECK_DESTROY(LogPortalGamemode, !foundPawn, "Player portal pawn could not be found in the portal class %s.", *GetName());
-	pawn = foundPawn;
-
-	// Set off timer to update the portals in the world.
-	if (performantPortals)
-	{
-		FTimerDelegate timer;
-		timer.BindUFunction(this, "UpdatePortals");
-		GetWorld()->GetTimerManager().SetTimer(portalsTimer, timer, portalUpdateRate, true);
-	}
+	// Let the portal manager activate the portals in the world as each viewers camera moves.
+	// NOTE: The portal manager finds the local players portal pawns itself so none are needed here.
+	UpdatePortals();
 }
 
 void ABetterPortalsGameModeBase::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	// NOT IN USE USING TIMER INSTEAD.
+	// NOT IN USE THE PORTAL MANAGER UPDATES THE PORTALS INSTEAD.
 }
 
 void ABetterPortalsGameModeBase::UpdatePortals()
 {
-	// Get all portals in the scene.
-	for (TActorIterator<AActor> portal(GetWorld(), APortal::StaticClass()); portal; ++portal)
-	{
-		APortal* foundPortal = Cast<APortal>(*portal);
-
-		// Get portal info.
-		FVector portalLoc = foundPortal->GetActorLocation();
-		FVector portalNorm = -1 * foundPortal->GetActorForwardVector();
-
-		// Get the pawns facing direction.
-		FVector pawnLoc = pawn->GetActorLocation();
-		FVector pawnDirection = pawn->camera->GetForwardVector();
-		FVector portalDirection = portalLoc - pawnLoc;
-
-		// Get the angle difference in their directions. In Degrees.
-		float angleDifference = FMath::Abs(FMath::Acos(FVector::DotProduct(pawnDirection, portalNorm))) * (180.0f / PI);
-		UE_LOG(LogTemp, Warning, TEXT("Angle Diff: %f"), angleDifference);
-
-		// Get distance from portal.
-		float portalDistance = FMath::Abs(portalDirection.Size());
-		float angleDiffAmount = portalDistance <= 1000.0f ? 130.0f : 90.0f;
-
-		// Activate the portals based on distance, if the camera is in-front and facing...
-		// NOTE: This is only an example of how the portals can be made less of an impact to performance.
-		// NOTE: It would be better to find a way of checking if portals are being rendered.
-		// to take it further you could check recursions to see if the portal actually needs to recurse itself.
-		bool looking = checkDirection ? angleDifference < angleDiffAmount : true;
-		if (foundPortal->IsInfront(pawnLoc) && looking && portalDistance <= maxPortalRenderDistance)
-		{
-			foundPortal->SetActive(true);
-		}
-		else
-		{
-			foundPortal->SetActive(false);
-		}
-	}
-}
\ No newline at end of file
+	// Portals are registered with the portal manager which only checks the portals near the camera.
+	APortalManager* portalManager = APortalManager::Get(GetWorld());
+	if (!portalManager) return;
+	portalManager->manageActivation = performantPortals;
+	portalManager->activationDistance = maxPortalRenderDistance;
+	portalManager->activationCheckDirection = checkDirection;
+	portalManager->activationMoveThreshold = portalUpdateDistance;
+	portalManager->RequestActivationUpdate();
+}
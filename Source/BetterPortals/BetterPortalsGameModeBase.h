@@ -17,7 +17,7 @@ class BETTERPORTALS_API ABetterPortalsGameModeBase : public AGameModeBase
 
 public:
 	
-	/* Should the game mode class activate/deactivate portals based on player location and distance. */
+	/* Should the portal manager activate/deactivate portals based on player location and distance. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
 	bool performantPortals;
 
@@ -26,27 +26,27 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
 	bool checkDirection;
 
-	/* Check for portals being rendered on screen every portalUpdateRate seconds. */
+	/* How far the camera can move before checking which portals should be active again. NOTE: Also checked when moving between grid cells. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
+	float portalUpdateDistance;
+
+	/* DEPRECATED: Portals used to be checked every portalUpdateRate seconds, the portal manager now checks them as the camera moves.
+	 * NOTE: Kept so saved game modes and Blueprint nodes using it still load, the seconds it holds can't be used as portalUpdateDistance. */
+	UPROPERTY(BlueprintReadWrite, Category = "Portal", meta = (DeprecatedProperty, DeprecationMessage = "Portals are checked as the camera moves instead of on a timer, use portalUpdateDistance."))
 	float portalUpdateRate;
 
 	/* Max distance to render a portal at. */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Portal")
 	float maxPortalRenderDistance;
 
-	/* Pointers to keep track of which portals to update. */
-	class APortalPawn* pawn;
-
-	/* Timer handle for the portals udpate function. */
-	FTimerHandle portalsTimer;
-
 public:
 
 	/* Constructor. */
 	ABetterPortalsGameModeBase();
 
-	/* Function to update portals in the world based off player location relative to each of them. */
-	UFUNCTION(Category = "Portals")
+	/* Pass the portal settings to the portal manager and update which portals are active on its next tick.
+	 * NOTE: The portal manager updates them by itself as the camera moves so only needed when changing these settings. */
+	UFUNCTION(BlueprintCallable, Category = "Portals")
 	void UpdatePortals();
 	
 protected:
@@ -2,9 +2,12 @@
 #include "Portal.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
 #include "Components/BoxComponent.h"
 #include "PhysicsEngine/PhysicsHandleComponent.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsEngine/PhysicsSettings.h"
 #include "GameFramework/PlayerController.h"
 #include "Materials/MaterialInstanceDynamic.h"
 #include "UObject/UObjectGlobals.h"
@@ -12,22 +15,30 @@
 #include "Engine/Engine.h"
 #include "Camera/CameraComponent.h"
 #include "Engine/LocalPlayer.h"
+#include "SceneView.h"
 #include "Plane.h"
 #include "PortalPawn.h"
 #include "PortalPlayer.h"
 #include "DrawDebugHelpers.h"
 #include "Kismet/KismetRenderingLibrary.h"
 #include "Engine/StaticMesh.h"
-#include "TimerManager.h"
+#include "Materials/MaterialInterface.h"
 #include "BetterPortalsGameModeBase.h"
+#include "PortalManager.h"
+#include "PortalReprojection.h"
 #include "Kismet/GameplayStatics.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Particles/ParticleSystemComponent.h"
+#include "Components/ModelComponent.h"
+#include "Engine/Level.h"
+#include "EngineUtils.h"
 
 DEFINE_LOG_CATEGORY(LogPortal);
 
 APortal::APortal()
 {
-	PrimaryActorTick.bCanEverTick = true;
-	PrimaryActorTick.TickGroup = ETickingGroup::TG_PostUpdateWork;
+	// NOTE: The portal manager updates every portal in one pass so portals don't tick themselves.
+	PrimaryActorTick.bCanEverTick = false;
 
 	// Create class default sub-objects.
 	RootComponent = CreateDefaultSubobject<USceneComponent>("RootComponent");
@@ -37,18 +48,20 @@ APortal::APortal()
 	portalMesh->SetCollisionObjectType(ECC_Portal);
 	portalMesh->SetupAttachment(RootComponent);
 	portalMesh->CastShadow = false; // Dont want it casting shadows.
+	portalMesh->SetGenerateOverlapEvents(false); // Found by the portal managers broadphase.
 
 	// Setup portal overlap box for detecting actors.
 	portalBox = CreateDefaultSubobject<UBoxComponent>(TEXT("PortalBox"));
-	portalBox->SetCollisionEnabled(ECollisionEnabled::QueryOnly);
-	portalBox->SetUseCCD(true);
+	// NOTE: Tested by the portal managers broadphase instead of generating overlaps.
 	portalBox->SetCollisionProfileName("Portal");
+	portalBox->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	portalBox->SetGenerateOverlapEvents(false);
 	portalBox->SetupAttachment(portalMesh);
 	
 	// Setup default scene capture comp.
 	portalCapture = CreateDefaultSubobject<USceneCaptureComponent2D>("PortalCapture");
 	portalCapture->SetupAttachment(RootComponent);
-	portalCapture->bEnableClipPlane = true;
+	portalCapture->bEnableClipPlane = false;
 	portalCapture->bUseCustomProjectionMatrix = false;
 	portalCapture->bCaptureEveryFrame = false;
 	portalCapture->bCaptureOnMovement = false;
@@ -56,96 +69,130 @@ APortal::APortal()
 	portalCapture->TextureTarget = nullptr;	
 	portalCapture->CaptureSource = ESceneCaptureSource::SCS_SceneColorSceneDepth;// Stores Scene Depth in A channel.
 
-	// Add post physics ticking function to this actor.
-	physicsTick.bCanEverTick = false;
-	physicsTick.Target = this;
-	physicsTick.TickGroup = TG_PostPhysics;
-
 	// Set active by default. 
     // NOTE: If performant portals is enabled in game mode portals will be deactivated until needed to be activated...
 	active = true;
 	initialised = false;
 	debugCameraTransform = false;
 	debugTrackedActors = false;
-	actorsBeingTracked = 0;
+	instancedDuplicates = false;
+	substepCrossings = false;
+	substepAperture = FTransform::Identity;
+	substepApertureExtent = FVector2D::ZeroVector;
+	substepToTarget = FTransform::Identity;
 	recursionAmount = 5;
 	resolutionPercentile = 1.0f;
+	minResolutionPercentile = 0.25f;
+	fullResolutionDistance = 500.0f;
+	minResolutionDistance = 3000.0f;
+	fullResolutionCoverage = 0.25f;
+	resolutionHysteresis = 0.15f;
+	updateRate = EPortalUpdateRate::AUTOMATIC;
+	updateFrameInterval = 2;
+	updateTimeInterval = 33.0f;
+	fullRateDistance = 1000.0f;
+	halfRateDistance = 2500.0f;
+	fullRateCoverage = 0.2f;
+	reprojectStaleCaptures = true;
+	currentFrameCount = 0;
+	updatePhase = 0;
+	lastUpdateTime = 0.0f;
+	lastScreenCoverage = 1.0f;
+	obliqueClipping = true;
+	cropCaptureToPortal = true;
+	recursionPixelThreshold = 256.0f;
+	stereoCaptures = true;
+	cacheCaptures = true;
+	captureCacheDistance = 3000.0f;
+	captureCacheMaxAge = 1.0f;
+	destinationHashFrame = 0;
+	frameDestinationHash = 0;
+	frameDestinationAnimated = false;
+	skippedCaptures = 0;
+	captureRequested = false;
+	lastCaptureCount = 1;
+	averageCaptureCost = 0.0f;
+	useShowOnlyList = false;
+	destinationViewDistance = 20000.0f;
+	numStaticShowOnly = 0;
+	showOnlySceneVersion = -1;
+	showOnlyTargetTransform = FTransform::Identity;
+
+	// Each recursion gets cheaper as it gets smaller on screen.
+	captureProfiles.Add(FPortalCaptureProfile(true, true, true, true, 3.0f, 0.0f));
+	captureProfiles.Add(FPortalCaptureProfile(false, true, true, true, 6.0f, 0.0f));
+	captureProfiles.Add(FPortalCaptureProfile(false, false, false, false, 10.0f, 10000.0f));
 }
 
 void APortal::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// Delay setup for 2 seconds.
-	PrimaryActorTick.SetTickFunctionEnable(false);
-	FTimerHandle timer;
-	FTimerDelegate timerDel;
-	timerDel.BindUFunction(this, "Setup");
-	GetWorldTimerManager().SetTimer(timer, timerDel, 1.0f, false, 1.0f);
-}
-
-void APortal::Setup()
-{
 	// If there is no target destroy and print log message.
 	pTargetPortal = Cast<APortal>(targetPortal);
 	CHECK_DESTROY(LogPortal, (!targetPortal || !pTargetPortal), "Portal %s, was destroyed as there was no target portal or it wasnt a type of APortal class.", *GetName());
 
-	// Save a reference to the player controller.
-	APlayerController* PC = GetWorld()->GetFirstPlayerController();
-	CHECK_DESTROY(LogPortal, !PC, "Player controller could not be found in the portal class %s.", *GetName());
-	portalController = PC;
-	APortalPawn* pawn = Cast<APortalPawn>(PC->GetPawn());
-	CHECK_DESTROY(LogPortal, !pawn, "Player portal pawn could not be found in the portal class %s.", *GetName());
-	portalPawn = pawn;
+	// Find the portal manager to borrow render targets from while active.
+	// NOTE: The portal manager also finds the local players viewing the portal, each gets its own view once they have a portal pawn.
+	portalManager = APortalManager::Get(GetWorld());
+	CHECK_DESTROY(LogPortal, !portalManager, "Portal manager could not be found or spawned in the portal class %s.", *GetName());
 
-	// Create a render target for this portal and its dynamic material instance. Then check if it has been successfully created.
-	CreatePortalTexture();
-	CHECK_DESTROY(LogPortal, (!renderTarget || !portalMaterial), "render target or portal material was null and could not be created in the portal class %s.", *GetName());
+	// Setup once the target portal has begun play. NOTE: The portal manager limits how many portals setup each frame.
+	portalManager->RequestSetup(this);
+}
 
-	// Register the secondary post physics tick function in the world on level start.
-	physicsTick.bCanEverTick = true;
-	physicsTick.RegisterTickFunction(GetWorld()->PersistentLevel);
+bool APortal::IsReadyForSetup() const
+{
+	return pTargetPortal && !pTargetPortal->IsPendingKill() && pTargetPortal->HasActorBegunPlay();
+}
 
-	// Begin play ran.
-	initialised = true;
+void APortal::Setup()
+{
+	if (initialised) return;
+	updatePhase = portalManager->GetNextUpdatePhase();
 
-	// Init last pawn location.
-	lastPawnLoc = portalPawn->camera->GetComponentLocation();
+	// Create the dynamic material instance for this portal. Then check if it has been successfully created.
+	// NOTE: The render target is borrowed from the portal manager when the portal is first rendered and each viewers view is made when
+	//       the viewer is first found.
+	CreatePortalTexture();
+	CHECK_DESTROY(LogPortal, !portalMaterial, "portal material was null and could not be created in the portal class %s.", *GetName());
 
-	// If playing game and is game world setup delegate bindings.
-	if (GetWorld() && GetWorld()->IsGameWorld())
+	// Only crop captures to the portal when its material can remap its screen UVs to the cropped capture.
+	// NOTE: Getting a parameter the material doesn't have returns false.
+	FLinearColor uvScaleBias;
+	if (cropCaptureToPortal && !portalMaterial->GetVectorParameterValue(FMaterialParameterInfo("PortalUVScaleBias"), uvScaleBias))
 	{
-		// Bind the portals overlap events.
-		portalBox->OnComponentBeginOverlap.AddDynamic(this, &APortal::OnPortalBoxOverlapStart);
-		portalBox->OnComponentEndOverlap.AddDynamic(this, &APortal::OnPortalBoxOverlapEnd);
-		portalMesh->OnComponentBeginOverlap.AddDynamic(this, &APortal::OnPortalMeshOverlapStart);
-		portalMesh->OnComponentEndOverlap.AddDynamic(this, &APortal::OnPortalMeshOverlapEnd);
+		UE_LOG(LogPortal, Verbose, TEXT("Portal %s can't crop its captures as its material has no PortalUVScaleBias parameter."), *GetName());
+		cropCaptureToPortal = false;
 	}
 
-	// Check if anything is already overlapping on begin play as overlap start will not be called in this case...
-	TSet<AActor*> overlappingActors;
-	portalBox->GetOverlappingActors(overlappingActors);
-	TArray<AActor*> overlappingActorsArr = overlappingActors.Array();
-	if (overlappingActorsArr.Num() > 0)
+	// Substep crossings need the physics scene to substep, the callbacks run once before integrating the whole frame otherwise.
+	if (substepCrossings && !UPhysicsSettings::Get()->bSubstepping)
 	{
-		// For each found overlapping actor on begin play check if it can move and started overlapping in-front of the portal, if so track it until it ends its overlap.
-		for (AActor* overlappedActor : overlappingActorsArr)
-		{
-			// If a physics enabled actor passes through the portal from the correct direction duplicate and track said object at the target portal.
-			USceneComponent* overlappedRootComponent = overlappedActor->GetRootComponent();
-			if (overlappedRootComponent && overlappedRootComponent->IsSimulatingPhysics())
-			{
-				// Ensure that the item thats entering the portal is in-front.
-				if (!trackedActors.Contains(overlappedActor) && IsInfront(overlappedRootComponent->GetComponentLocation()))
-				{
-					AddTrackedActor(overlappedActor);
-				}
-			}
-		}
+		UE_LOG(LogPortal, Warning, TEXT("Portal %s has substepCrossings enabled but substepping is disabled in the physics settings, crossings are only found after physics."), *GetName());
+	}
+
+	// Setup ran.
+	initialised = true;
+
+	// Register with the portal manager so it can activate and update this portal.
+	// NOTE: The portal manager finds this frames visible portals before updating them.
+	// NOTE: Anything already inside the portal box is found by the portal managers next broadphase.
+	portalManager->RegisterPortal(this);
+}
+
+void APortal::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// Give the render targets back to the pool.
+	ReleasePortalTextures();
+	if (portalManager)
+	{
+		portalManager->CancelSetup(this);
+		for (int viewer = 1; viewer < views.Num(); viewer++) portalManager->UnregisterViewerMesh(viewer, views[viewer].mesh);
+		portalManager->UnregisterPortal(this);
 	}
 
-	// After setup is done enable ticking functions.
-	PrimaryActorTick.SetTickFunctionEnable(true);
+	Super::EndPlay(EndPlayReason);
 }
 
 void APortal::PostInitializeComponents()
@@ -159,86 +206,141 @@ void APortal::PostPhysicsTick(float DeltaTime)
 	// If the portal is currently active.
 	if (active)
 	{
-		// Check if the pawn has passed through this portal.
+		// Check if any of the viewers pawns have passed through this portal.
+		// NOTE: Tracked actors are updated for every portal at once by the portal manager after this.
+		UpdateViews();
 		UpdatePawnTracking();
-
-		// Update tracked actors post physics...
-		UpdateTrackedActors();
 	}
 }
 
-void APortal::Tick(float DeltaTime)
+void APortal::UpdatePortal(float DeltaTime)
 {
-	Super::Tick(DeltaTime);
-
-	// If begin play has been ran.
+	// If setup has been ran.
 	if (initialised)
 	{
-		// Clear portal information.
-		portalMaterial->SetScalarParameterValue("ScaleOffset", 0.0f);
-		ClearPortalView();
+		// Match the views to the local players viewing the portal.
+		// NOTE: Only called for active portals, the world offset is cleared when the portal is deactivated.
+		UpdateViews();
 
-		// If the portal is active.
-		if (active)
+		// If the portal is active and being viewed.
+		if (active && views.Num() > 0)
 		{
-			// Update the portals view.
-			UpdatePortalView();
-
-			// Check if the player needs teleporting through this portal.
-			if (LocationInsidePortal(portalPawn->camera->GetComponentLocation()))
+			// Update the portals view if its due this frame and has changed, otherwise keep the last view.
+			// NOTE: When the portal manager schedules captures the request is kept until the manager has budget for it.
+			if (IsUpdateDue() || captureRequested)
 			{
-				// Update world offset to prevent clipping.
-				portalMaterial->SetScalarParameterValue("ScaleOffset", 1.0f);
+				if (IsCaptureCached())
+				{
+					skippedCaptures += views.Num();
+					captureRequested = false;
+				}
+				else if (portalManager->scheduleCaptures)
+				{
+					captureRequested = true;
+					portalManager->RequestCapture(this);
+				}
+				else UpdatePortalView();
 			}
+
+			// Update world offset to prevent clipping for viewers inside the portal.
+			UpdateWorldOffset();
 		}
 	}
 }
 
-void APortal::OnPortalBoxOverlapStart(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex, bool fromSweep, const FHitResult& portalHit)
+void APortal::GetBroadphaseProxy(FPortalBroadphaseProxy& outProxy) const
+{
+	outProxy.bounds = portalBox->Bounds.GetBox() + portalMesh->Bounds.GetBox();
+
+	// The portal box around its center.
+	FTransform boxTransform = portalBox->GetComponentTransform();
+	outProxy.boxTransform = FTransform(boxTransform.GetRotation(), boxTransform.GetLocation());
+	outProxy.boxExtent = portalBox->GetScaledBoxExtent();
+	outProxy.boxResponses = portalBox->GetCollisionResponseToChannels();
+
+	// The portal meshes local bounds around their center.
+	FTransform meshTransform = portalMesh->GetComponentTransform();
+	FBoxSphereBounds localBounds = portalMesh->CalcBounds(FTransform::Identity);
+	outProxy.meshTransform = FTransform(meshTransform.GetRotation(), meshTransform.TransformPosition(localBounds.Origin));
+	outProxy.meshExtent = localBounds.BoxExtent * meshTransform.GetScale3D().GetAbs();
+	outProxy.boxComponentTransform = boxTransform;
+	outProxy.meshComponentTransform = meshTransform;
+}
+
+bool APortal::IsBroadphaseProxyCurrent(const FPortalBroadphaseProxy& proxy) const
+{
+	return portalBox->GetComponentTransform().Equals(proxy.boxComponentTransform, 0.0f) && portalMesh->GetComponentTransform().Equals(proxy.meshComponentTransform, 0.0f);
+}
+
+void APortal::ApplyBroadphase(const FPortalOverlaps& overlaps)
+{
+	// Hide and stop tracking what has left first so an actor leaving one portal and entering another keeps its order of events.
+	// NOTE: Linear scans as only a few bodies are ever near one portal, null if they were destroyed and garbage collected.
+	for (AActor* actor : meshOverlaps)
+	{
+		if (actor && !overlaps.meshActors.Contains(actor)) OnPortalMeshExit(actor);
+	}
+	for (AActor* actor : boxOverlaps)
+	{
+		if (actor && !overlaps.boxActors.Contains(actor)) OnPortalBoxExit(actor);
+	}
+
+	// Then track and show what has entered.
+	for (int i = 0; i < overlaps.boxActors.Num(); i++)
+	{
+		if (!boxOverlaps.Contains(overlaps.boxActors[i])) OnPortalBoxEnter(overlaps.boxActors[i], overlaps.boxOrigins[i]);
+	}
+	for (AActor* actor : overlaps.meshActors)
+	{
+		if (!meshOverlaps.Contains(actor)) OnPortalMeshEnter(actor);
+	}
+	boxOverlaps.Reset();
+	boxOverlaps.Append(overlaps.boxActors);
+	meshOverlaps.Reset();
+	meshOverlaps.Append(overlaps.meshActors);
+
+	// The portal manager only flushes the target portals of active portals so send any duplicates removed or hidden here now.
+	if (!active && pTargetPortal) pTargetPortal->FlushDuplicateInstances();
+}
+
+void APortal::OnPortalBoxEnter(AActor* enteringActor, const FVector& lastOrigin)
 {
 	// If a physics enabled actor passes through the portal from the correct direction, track said object at the target portal to determine when to teleport it.
-	USceneComponent* overlappedRootComponent = overlappedActor->GetRootComponent();
-	if (overlappedRootComponent && overlappedRootComponent->IsSimulatingPhysics())
+	// NOTE: The broadphase only finds physics simulating actors.
+	if (!trackedActors.Contains(enteringActor) && IsInfront(lastOrigin))
 	{
-		// Ensure that the item thats entering the portal is in-front.
-		if (!trackedActors.Contains(overlappedActor) && IsInfront(overlappedRootComponent->GetComponentLocation()))
-		{
-			AddTrackedActor(overlappedActor);
-		}
+		AddTrackedActor(enteringActor);
+
+		// Track from last frame so a body that passed through the portal within the frame is still teleported.
+		int32 index = trackedActors.GetIndex(trackedActors.Find(enteringActor));
+		if (index != INDEX_NONE) trackedActors.lastOrigins[index] = lastOrigin;
 	}
 }
 
-void APortal::OnPortalBoxOverlapEnd(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex)
+void APortal::OnPortalBoxExit(AActor* exitingActor)
 {
 	// Remove the actor. Does nothing if the actor isn't being tracked. Will check this.
-	if (trackedActors.Contains(overlappedActor))
+	if (trackedActors.Contains(exitingActor))
 	{
-		RemoveTrackedActor(overlappedActor);
+		RemoveTrackedActor(exitingActor);
 	}
 }
 
-void APortal::OnPortalMeshOverlapStart(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex, bool fromSweep, const FHitResult& portalHit)
+void APortal::OnPortalMeshEnter(AActor* enteringActor)
 {
 	// Unhide the actor once its overlapping with the portal itself.
-	if (trackedActors.Contains(overlappedActor))
-	{
-		if (AActor* hasDuplicate = trackedActors.FindRef(overlappedActor).trackedDuplicate)
-		{
-			HideActor(hasDuplicate, false);
-		}
-	}
+	HideDuplicate(enteringActor, false);
 }
 
-void APortal::OnPortalMeshOverlapEnd(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex)
+void APortal::OnPortalMeshExit(AActor* exitingActor)
 {
 	// Hide the actor once its ended its overlap with the portal by exiting it not passing through it.
-	if (trackedActors.Contains(overlappedActor))
-	{
-		if (AActor* hasDuplicate = trackedActors.FindRef(overlappedActor).trackedDuplicate)
-		{
-			HideActor(hasDuplicate);
-		}
-	}
+	HideDuplicate(exitingActor);
+}
+
+void APortal::OnTrackedActorDestroyed(AActor* destroyedActor)
+{
+	RemoveTrackedActor(destroyedActor);
 }
 
 bool APortal::IsActive()
@@ -250,6 +352,17 @@ void APortal::SetActive(bool activate)
 {
 	active = activate;
 	currentFrameCount = 0;
+	captureRequested = false;
+
+	// Inactive portals don't need a render target so give it back for other portals to use.
+	// NOTE: The world offset and last frames substep bodies are cleared once here as inactive portals aren't updated.
+	if (!active)
+	{
+		ReleasePortalTextures();
+		for (FPortalView& view : views) view.material->SetScalarParameterValue("ScaleOffset", 0.0f);
+		QueueSubstepCrossings();
+	}
+	if (portalManager) portalManager->OnPortalActiveChanged(this);
 }
 
 void APortal::HideActor(AActor* actor, bool hide)
@@ -265,19 +378,41 @@ void APortal::HideActor(AActor* actor, bool hide)
 	}
 }
 
+void APortal::HideDuplicate(AActor* actor, bool hide)
+{
+	FTrackedActorHandle trackedActor = trackedActors.Find(actor);
+	int32 index = trackedActors.GetIndex(trackedActor);
+	if (index == INDEX_NONE) return;
+
+	// Instances are hidden by the target portal that owns them.
+	int32 instancer = trackedActors.instancers[index];
+	if (instancer != INDEX_NONE)
+	{
+		if (pTargetPortal && pTargetPortal->duplicateInstancers.IsValidIndex(instancer))
+		{
+			pTargetPortal->duplicateInstancers[instancer].SetInstanceHidden(trackedActors.instances[index], hide);
+		}
+	}
+	else if (AActor* hasDuplicate = trackedActors.duplicates[index]) HideActor(hasDuplicate, hide);
+}
+
+void APortal::FlushDuplicateInstances()
+{
+	for (FDuplicateInstancer& instancer : duplicateInstancers)
+	{
+		instancer.Flush();
+	}
+}
+
 void APortal::AddTrackedActor(AActor* actorToAdd)
 {
 	// Ensure the actor is not null.
 	if (actorToAdd == nullptr) return;
 
-	// Create tracked actor struct.
-	// NOTE: If its the pawn track the camera otherwise track the root component...
-	FTrackedActor track = FTrackedActor(actorToAdd->GetRootComponent());
-	track.lastTrackedOrigin = actorToAdd->GetActorLocation();
-
 	// Add to tracked actors.
-	trackedActors.Add(actorToAdd, track);
-	actorsBeingTracked++;
+	// NOTE: If its the pawn track the camera otherwise track the root component...
+	trackedActors.Add(actorToAdd, actorToAdd->GetRootComponent(), actorToAdd->GetActorLocation());
+	actorToAdd->OnDestroyed.AddUniqueDynamic(this, &APortal::OnTrackedActorDestroyed);
 
 	// Debug tracked actor.
 	if (debugTrackedActors) UE_LOG(LogPortal, Log, TEXT("Added new tracked actor %s."), *actorToAdd->GetName());
@@ -295,8 +430,8 @@ void APortal::RemoveTrackedActor(AActor* actorToRemove)
 	DeleteCopy(actorToRemove);
 
 	// Remove tracked actor.
-	trackedActors.Remove(actorToRemove);
-	actorsBeingTracked--;
+	trackedActors.Remove(trackedActors.Find(actorToRemove));
+	actorToRemove->OnDestroyed.RemoveDynamic(this, &APortal::OnTrackedActorDestroyed);
 
 	// Debug tracked actor.
 	if (debugTrackedActors) UE_LOG(LogPortal, Log, TEXT("Removed tracked actor %s."), *actorToRemove->GetName());
@@ -304,166 +439,982 @@ void APortal::RemoveTrackedActor(AActor* actorToRemove)
 
 void APortal::CreatePortalTexture()
 {		
-	// Create default texture size.
-	int32 viewportX, viewportY;
-	portalController->GetViewportSize(viewportX, viewportY);
-	viewportX *= resolutionPercentile;
-	viewportY *= resolutionPercentile;
-	UE_LOG(LogPortal, Log, TEXT("Portal render target created with width: %f and height: %f"), (float)viewportX, (float)viewportY);
-
-	// Create new render texture.
-	renderTarget = nullptr;
-	renderTarget = UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(GetWorld(), UCanvasRenderTarget2D::StaticClass(), viewportX, viewportY);
-
 	// Create the dynamic material instance for the portal mesh to show the render texture.
+	// NOTE: Views are created for each viewer once the portal manager has found them.
+	views.Reset();
 	portalMaterial = portalMesh->CreateDynamicMaterialInstance(0, portalMaterialInstance);
-	portalMaterial->SetTextureParameterValue("RT_Portal", renderTarget);
+}
 
-	// Assign the Render Target
-	portalCapture->TextureTarget = renderTarget;
+void APortal::UpdateViews()
+{
+	// Remove the views of viewers that have left.
+	int numViewers = portalManager->GetNumViewers();
+	while (views.Num() > numViewers)
+	{
+		int viewer = views.Num() - 1;
+		ReleasePortalTexture(viewer, 0);
+		ReleasePortalTexture(viewer, 1);
+		if (viewer > 0)
+		{
+			portalManager->UnregisterViewerMesh(viewer, views[viewer].mesh);
+			views[viewer].mesh->DestroyComponent();
+		}
+		views.Pop();
+	}
+
+	for (int viewer = 0; viewer < numViewers; viewer++)
+	{
+		// Add a view for each new viewer. The first viewer uses the portal mesh, the others get a copy only they can see.
+		if (!views.IsValidIndex(viewer))
+		{
+			FPortalView newView;
+			if (viewer == 0)
+			{
+				newView.mesh = portalMesh;
+				newView.material = portalMaterial;
+			}
+			else
+			{
+				FName meshName = MakeUniqueObjectName(this, UStaticMeshComponent::StaticClass(), "PortalViewMesh");
+				UStaticMeshComponent* viewMesh = NewObject<UStaticMeshComponent>(this, meshName);
+				viewMesh->SetMobility(portalMesh->Mobility);
+				viewMesh->SetStaticMesh(portalMesh->GetStaticMesh());
+				viewMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+				viewMesh->CastShadow = false;
+				viewMesh->SetupAttachment(portalMesh);
+				viewMesh->RegisterComponent();
+				newView.mesh = viewMesh;
+				newView.material = viewMesh->CreateDynamicMaterialInstance(0, portalMaterialInstance);
+				portalManager->RegisterViewerMesh(viewer, viewMesh);
+			}
+			views.Add(newView);
+		}
+
+		// Start again if a different player has taken the viewers place.
+		FPortalView& view = views[viewer];
+		const FPortalViewer& portalViewer = portalManager->GetViewer(viewer);
+		if (view.controller != portalViewer.controller)
+		{
+			view.controller = portalViewer.controller;
+			view.cached = false;
+			view.resolution = resolutionPercentile;
+			view.lastPawnLoc = portalViewer.pawn->camera->GetComponentLocation();
+		}
+	}
+}
+
+bool APortal::UpdatePortalTexture(int viewer, FIntPoint size, int eye)
+{
+	// Keep the current render target if it is in the right size bucket or at most one bucket bigger.
+	// NOTE: Saves swapping render targets back and forth when the size is near the edge of a bucket.
+	FPortalView& view = views[viewer];
+	UCanvasRenderTarget2D*& eyeRenderTarget = eye == 1 ? view.renderTargetRight : view.renderTarget;
+	FIntPoint bucketSize = FPortalRenderTargetPool::GetBucketSize(size);
+	FIntPoint nextBucketSize = FPortalRenderTargetPool::GetBucketSize(bucketSize + FIntPoint(1, 1));
+	if (eyeRenderTarget && eyeRenderTarget->SizeX >= bucketSize.X && eyeRenderTarget->SizeY >= bucketSize.Y &&
+		eyeRenderTarget->SizeX <= nextBucketSize.X && eyeRenderTarget->SizeY <= nextBucketSize.Y) return true;
+
+	// Swap for a render target of the new size from the pool.
+	// NOTE: Assigned to the material and scene capture when captured.
+	ReleasePortalTexture(viewer, eye);
+	eyeRenderTarget = portalManager->AcquireRenderTarget(size);
+	return eyeRenderTarget != nullptr;
+}
+
+UCanvasRenderTarget2D* APortal::GetPortalTexture(int viewer, int eye) const
+{
+	return eye == 1 ? views[viewer].renderTargetRight : views[viewer].renderTarget;
+}
+
+UCanvasRenderTarget2D* APortal::GetShownPortalTexture(int viewer, int eye) const
+{
+	const FPortalView& view = views[viewer];
+	if (view.reprojected[eye]) return eye == 1 ? view.reprojectedTargetRight : view.reprojectedTarget;
+	return GetPortalTexture(viewer, eye);
+}
+
+bool APortal::HasPortalTextures(int viewer) const
+{
+	const FPortalView& view = views[viewer];
+	return view.renderTarget && (!view.stereo || view.renderTargetRight);
+}
+
+bool APortal::HasPortalTextures() const
+{
+	for (int viewer = 0; viewer < views.Num(); viewer++)
+	{
+		if (!HasPortalTextures(viewer)) return false;
+	}
+	return views.Num() > 0;
+}
+
+float APortal::UpdateResolution(FPortalView& view, const FBox2D& screenBounds, const FVector& cameraLocation)
+{
+	// Drop the resolution with distance.
+	float distanceRange = FMath::Max(minResolutionDistance - fullResolutionDistance, 1.0f);
+	float distanceAlpha = FMath::Clamp((GetDistanceToPortal(cameraLocation) - fullResolutionDistance) / distanceRange, 0.0f, 1.0f);
+	float wantedResolution = FMath::Lerp(resolutionPercentile, minResolutionPercentile, distanceAlpha);
+
+	// Drop the resolution for portals covering a small amount of the screen.
+	FVector2D coverage = screenBounds.GetSize();
+	if (fullResolutionCoverage > 0.0f) wantedResolution *= FMath::Min(FMath::Sqrt(coverage.X * coverage.Y / fullResolutionCoverage), 1.0f);
+	wantedResolution = FMath::Clamp(wantedResolution, minResolutionPercentile, resolutionPercentile);
+
+	// Only apply if its changed enough from the current resolution or it has reached either of the limits.
+	bool atLimit = wantedResolution == minResolutionPercentile || wantedResolution == resolutionPercentile;
+	if (atLimit || FMath::Abs(wantedResolution - view.resolution) > view.resolution * resolutionHysteresis)
+	{
+		view.resolution = wantedResolution;
+	}
+	view.resolution = FMath::Clamp(view.resolution, minResolutionPercentile, resolutionPercentile);
+	return view.resolution;
+}
+
+void APortal::ReleasePortalTexture(int viewer, int eye)
+{
+	if (!views.IsValidIndex(viewer)) return;
+	FPortalView& view = views[viewer];
+	UCanvasRenderTarget2D*& eyeRenderTarget = eye == 1 ? view.renderTargetRight : view.renderTarget;
+	if (eyeRenderTarget)
+	{
+		if (portalManager) portalManager->ReleaseRenderTarget(eyeRenderTarget);
+		if (view.material)
+		{
+			SetMaterialEyeTexture(view.material, eye, nullptr);
+			if (eye == 0 && !view.stereo) SetMaterialEyeTexture(view.material, 1, nullptr);
+		}
+		if (portalCapture->TextureTarget == eyeRenderTarget) portalCapture->TextureTarget = nullptr;
+		eyeRenderTarget = nullptr;
+	}
+
+	// The warped capture is only valid with the capture it came from.
+	UCanvasRenderTarget2D*& eyeReprojectedTarget = eye == 1 ? view.reprojectedTargetRight : view.reprojectedTarget;
+	if (eyeReprojectedTarget && portalManager) portalManager->ReleaseRenderTarget(eyeReprojectedTarget);
+	eyeReprojectedTarget = nullptr;
+	view.reprojected[eye] = false;
+}
+
+void APortal::ReleasePortalTextures()
+{
+	for (int viewer = 0; viewer < views.Num(); viewer++)
+	{
+		ReleasePortalTexture(viewer, 0);
+		ReleasePortalTexture(viewer, 1);
+	}
 }
 
 void APortal::ClearPortalView()
 {
 	// Force portal to be a random color that can be found as mask.
-	UKismetRenderingLibrary::ClearRenderTarget2D(GetWorld(), renderTarget);
+	for (FPortalView& view : views)
+	{
+		if (view.renderTarget) UKismetRenderingLibrary::ClearRenderTarget2D(GetWorld(), view.renderTarget);
+		if (view.renderTargetRight) UKismetRenderingLibrary::ClearRenderTarget2D(GetWorld(), view.renderTargetRight);
+	}
 }
 
 void APortal::UpdatePortalView()
 {
 	// Increase current frame count.
 	currentFrameCount++;
-
-	// Get cameras post-processing settings.
-	portalCapture->PostProcessSettings = portalPawn->camera->PostProcessSettings;
+	lastUpdateTime = GetWorld()->GetTimeSeconds();
+	UpdateViews();
 
 	// Setup clip plane to cut out objects between the camera and the back of the portal.
-	portalCapture->bEnableClipPlane = true;
+	FPlane clipPlane = UpdateCaptureClipPlane();
+
+	// Only render what can be seen through the target portal. NOTE: Shared between every viewer and both eyes when rendering in stereo.
+	UpdateShowOnlyList();
+
+	// Captures only see the portals through the first viewers meshes.
+	portalCapture->HiddenComponents = portalManager->GetCaptureHiddenMeshes();
+
+	lastScreenCoverage = 0.0f;
+	for (int viewer = 0; viewer < views.Num(); viewer++)
+	{
+		// Keep the viewers last capture if nothing it can see has changed.
+		FPortalView& view = views[viewer];
+		if (IsViewCached(viewer))
+		{
+			skippedCaptures++;
+			lastScreenCoverage = FMath::Max(lastScreenCoverage, view.screenCoverage);
+			continue;
+		}
+		view.cached = false;
+		view.lastCaptureTime = lastUpdateTime;
+		view.captureFrame = GFrameCounter;
+
+		// Force the view to be a random color that can be found as mask.
+		if (view.renderTarget) UKismetRenderingLibrary::ClearRenderTarget2D(GetWorld(), view.renderTarget);
+		if (view.renderTargetRight) UKismetRenderingLibrary::ClearRenderTarget2D(GetWorld(), view.renderTargetRight);
+
+		// Get the viewers cameras post-processing settings.
+		const FPortalViewer& portalViewer = portalManager->GetViewer(viewer);
+		UCameraComponent* playerCamera = portalViewer.pawn->camera;
+		portalCapture->PostProcessSettings = playerCamera->PostProcessSettings;
+
+		// Capture each eye into its own render target when rendering in stereo, otherwise capture the full view.
+		// NOTE: The right eye is captured last so the viewers material parameters end up pointing at each eyes own capture.
+		view.stereo = stereoCaptures && portalViewer.player->IsStereoEnabled();
+		if (view.stereo)
+		{
+			CapturePortalView(viewer, EStereoscopicPass::eSSP_LEFT_EYE, clipPlane);
+			CapturePortalView(viewer, EStereoscopicPass::eSSP_RIGHT_EYE, clipPlane);
+		}
+		else
+		{
+			ReleasePortalTexture(viewer, 1);
+			CapturePortalView(viewer, EStereoscopicPass::eSSP_FULL, clipPlane);
+		}
+		lastScreenCoverage = FMath::Max(lastScreenCoverage, view.screenCoverage);
+		if (!HasPortalTextures(viewer)) continue;
+
+		// Remember what was captured so the next update can be skipped if none of it changes.
+		// NOTE: While the camera is moving the next update can't be skipped anyway so the destination isn't queried until it stops.
+		if (cacheCaptures)
+		{
+			FPortalTransform& portalTransform = GetTargetTransform();
+			FVector captureLoc = portalTransform.TransformLocation(playerCamera->GetComponentLocation());
+			FQuat captureRot = portalTransform.TransformRotation(playerCamera->GetComponentQuat());
+			bool cameraMoved = !captureLoc.Equals(view.lastCaptureLoc, 0.01f) || !captureRot.Equals(view.lastCaptureRot, 1.e-5f);
+			view.lastCaptureLoc = captureLoc;
+			view.lastCaptureRot = captureRot;
+			view.lastCaptureProjection = portalViewer.player->GetCameraProjectionMatrix();
+			portalViewer.controller->GetViewportSize(view.lastViewportSize.X, view.lastViewportSize.Y);
+			if (!cameraMoved)
+			{
+				bool animated = false;
+				view.lastDestinationHash = GetDestinationHash(animated);
+				view.cached = !animated;
+			}
+		}
+	}
+}
+
+FPlane APortal::UpdateCaptureClipPlane()
+{
+	// NOTE: When using oblique clipping the plane is built into the projection matrix for each recursion instead.
+	portalCapture->bEnableClipPlane = !obliqueClipping;
 	portalCapture->bOverride_CustomNearClippingPlane = true;
 	portalCapture->ClipPlaneNormal = pTargetPortal->portalMesh->GetForwardVector();
 	portalCapture->ClipPlaneBase = pTargetPortal->portalMesh->GetComponentLocation() - (portalCapture->ClipPlaneNormal * 1.0f);
+	return FPlane(portalCapture->ClipPlaneBase, portalCapture->ClipPlaneNormal);
+}
+
+bool APortal::CapturePortalView(int viewer, EStereoscopicPass pass, const FPlane& clipPlane)
+{
+	int eye = pass == EStereoscopicPass::eSSP_RIGHT_EYE ? 1 : 0;
+	FPortalView& view = views[viewer];
+	const FPortalViewer& portalViewer = portalManager->GetViewer(viewer);
+
+	// Get the Projection Matrix from the viewers camera view settings for this eye.
+	FSceneViewProjectionData projectionData;
+	if (!portalViewer.player->GetCameraProjectionData(pass, projectionData)) return false;
+	FMatrix projectionMatrix = projectionData.ProjectionMatrix;
+	FMatrix fullProjectionMatrix = projectionMatrix;
+	FIntPoint viewSize = projectionData.GetConstrainedViewRect().Size();
+
+	// Find the portals bounds on screen. If its not on screen there is nothing to render.
+	// NOTE: When the camera is inside the portal box the mesh is offset around the camera so use the full screen.
+	UCameraComponent* playerCamera = portalViewer.pawn->camera;
+	FVector playerCamLoc = projectionData.ViewOrigin;
+	FQuat playerCamRot = playerCamera->GetComponentQuat();
+	FBox2D screenBounds = FBox2D(FVector2D(0.0f, 0.0f), FVector2D(1.0f, 1.0f));
+	if (!LocationInsidePortal(playerCamera->GetComponentLocation()))
+	{
+		FVector portalCorners[4];
+		GetPortalCorners(portalCorners);
+		if (!FPortalMath::GetScreenBounds(projectionData.ComputeViewProjectionMatrix(), portalCorners, 4, screenBounds))
+		{
+			// Nothing to render so the render target can be used by another portal.
+			ReleasePortalTexture(viewer, eye);
+			return false;
+		}
+	}
 
-	// Get the Projection Matrix from the players camera view settings.
-	UPortalPlayer* portalPlayer = Cast<UPortalPlayer>(portalController->GetLocalPlayer());
-	CHECK_DESTROY(LogPortal, !portalPlayer, "UpdatePortalView: Portal player class couldn't be found in the portal %s.", *GetName());
+	// Crop the projection to the portals bounds on screen so only what can be seen through the portal is rendered.
+	// NOTE: The coverage of both eyes is kept when rendering in stereo. Stereo views aren't cropped as M_PortalVR samples each eye
+	//       with plain screen UVs and has no scale and bias parameters.
+	view.screenCoverage = eye == 1 ? FMath::Max(view.screenCoverage, screenBounds.GetArea()) : screenBounds.GetArea();
+	FVector2D targetSize = FVector2D(viewSize.X, viewSize.Y) * UpdateResolution(view, screenBounds, playerCamera->GetComponentLocation());
+	bool cropped = cropCaptureToPortal && !view.stereo;
+	if (cropped)
+	{
+		projectionMatrix = FPortalMath::CropProjectionMatrix(projectionMatrix, screenBounds);
+		targetSize *= screenBounds.GetSize();
+		view.scaleBias[eye] = FPortalMath::GetScreenUVScaleBias(screenBounds);
+	}
+	else view.scaleBias[eye] = FLinearColor(1.0f, 1.0f, 0.0f, 0.0f);
+
+	// Remember the captures screen space so it can be warped to later views in the same space.
+	// NOTE: The oblique near plane only changes depth so the cropped projection unprojects the capture, its depth is kept after capturing.
+	view.captureBounds[eye] = cropped ? screenBounds : FBox2D(FVector2D(0.0f, 0.0f), FVector2D(1.0f, 1.0f));
+	view.captureUnproject[eye] = FPortalMath::GetUnprojectParameters(projectionMatrix);
+	view.reprojected[eye] = false;
+
+	// Borrow a render target of the needed size from the pool. NOTE: Sizes are bucketed to avoid swapping for small movements.
+	if (!UpdatePortalTexture(viewer, FIntPoint(FMath::CeilToInt(targetSize.X), FMath::CeilToInt(targetSize.Y)), eye)) return false;
+	UCanvasRenderTarget2D* eyeRenderTarget = GetPortalTexture(viewer, eye);
+
+	// Capture the other portals seen through this one from this eye first so they show their view through this portal.
+	// NOTE: Uses this captures projection so they can be sampled with the same screen UVs.
+	TArray<APortal*> swappedPortals;
+	TArray<UCanvasRenderTarget2D*> borrowedTargets;
+	int rootNode = portalManager->FindRootViewNode(viewer, this);
+	if (rootNode != INDEX_NONE)
+	{
+		FIntPoint size = FIntPoint(eyeRenderTarget->SizeX, eyeRenderTarget->SizeY);
+		for (int childNode : portalManager->GetViewNode(rootNode).children)
+		{
+			APortal* childPortal = portalManager->GetViewNode(childNode).portal;
+			UCanvasRenderTarget2D* childTarget = childPortal->CaptureViewNode(childNode, playerCamLoc, playerCamRot, projectionMatrix, size, swappedPortals, borrowedTargets);
+			if (childTarget)
+			{
+				childPortal->SetPortalMaterialView(childTarget, FLinearColor(1.0f, 1.0f, 0.0f, 0.0f));
+				swappedPortals.AddUnique(childPortal);
+			}
+		}
+	}
+	portalCapture->TextureTarget = eyeRenderTarget;
 	portalCapture->bUseCustomProjectionMatrix = true;
-	portalCapture->CustomProjectionMatrix = portalPlayer->GetCameraProjectionMatrix();
+	portalCapture->CustomProjectionMatrix = projectionMatrix;
 
-	// Get reference to player camera.
-	UCameraComponent* playerCamera = portalPawn->camera;
+	// Captures see the recursive portal in their own cropped space so they sample it with their own screen UVs.
+	// NOTE: Captures are mono so the recursive portal samples the left eye parameters for both eyes. Captures only see the first
+	//       viewers mesh so its material is used for every viewer.
+	SetMaterialEyeTexture(portalMaterial, 0, eyeRenderTarget);
+	portalMaterial->SetVectorParameterValue("PortalUVScaleBias", FLinearColor(1.0f, 1.0f, 0.0f, 0.0f));
 
 	// Get the position of the main camera transform to the target portal.
-	FVector newCameraLocation = ConvertLocationToPortal(playerCamera->GetComponentLocation(), this, pTargetPortal);
-	FRotator newCameraRotation = ConvertRotationToPortal(playerCamera->GetComponentRotation(), this, pTargetPortal);
+	FPortalTransform& portalTransform = GetTargetTransform();
+	TArray<FVector, TInlineAllocator<8>> recursiveCamLocs;
+	TArray<FQuat, TInlineAllocator<8>> recursiveCamRots;
+	recursiveCamLocs.Add(portalTransform.TransformLocation(playerCamLoc));
+	recursiveCamRots.Add(portalTransform.TransformRotation(playerCamRot));
+	view.captureViewLoc[eye] = recursiveCamLocs[0];
+	view.captureViewRot[eye] = recursiveCamRots[0];
+
+	// Find how many recursions are needed. Stop once this portal is behind, off screen, hidden or smaller than the pixel threshold
+	// when seen through the last recursion. NOTE: Screen space is shared between each recursion so the visible bounds only ever shrink.
+	FVector portalCorners[4];
+	GetPortalCorners(portalCorners);
+	FBox2D visibleBounds = screenBounds;
+	for (int i = 1; i <= recursionAmount && portalMesh->IsVisible(); i++)
+	{
+		FVector lastCamLoc = recursiveCamLocs.Last();
+		FQuat lastCamRot = recursiveCamRots.Last();
+		if (!IsInfront(lastCamLoc)) break;
+
+		// Clip the recursive portals bounds by the area its visible through.
+		FBox2D recursiveBounds;
+		FMatrix recursiveViewProjection = FPortalMath::MakeViewProjectionMatrix(lastCamLoc, lastCamRot, fullProjectionMatrix);
+		if (!FPortalMath::GetScreenBounds(recursiveViewProjection, portalCorners, 4, recursiveBounds)) break;
+		visibleBounds.Min = FVector2D(FMath::Max(visibleBounds.Min.X, recursiveBounds.Min.X), FMath::Max(visibleBounds.Min.Y, recursiveBounds.Min.Y));
+		visibleBounds.Max = FVector2D(FMath::Min(visibleBounds.Max.X, recursiveBounds.Max.X), FMath::Min(visibleBounds.Max.Y, recursiveBounds.Max.Y));
+		FVector2D visiblePixels = (visibleBounds.Max - visibleBounds.Min) * FVector2D(viewSize.X, viewSize.Y);
+		if (visiblePixels.X <= 0.0f || visiblePixels.Y <= 0.0f || visiblePixels.X * visiblePixels.Y < recursionPixelThreshold) break;
+
+		// Add the next recursion from the players camera so errors don't build up between each recursion.
+		const FTransform& recursiveTransform = portalTransform.GetRecursiveTransform(i + 1);
+		recursiveCamLocs.Add(recursiveTransform.TransformPositionNoScale(playerCamLoc));
+		recursiveCamRots.Add(recursiveTransform.GetRotation() * playerCamRot);
+	}
 
-	// Recurse backwards for the max number of recursions and render to the texture each time overlaying each portal view.
-	for (int i = recursionAmount; i >= 0; i--)
+	// Recurse backwards from the deepest visible recursion and render to the texture each time overlaying each portal view.
+	int deepestRecursion = recursiveCamLocs.Num() - 1;
+	lastCaptureCount = eye == 1 ? FMath::Max(lastCaptureCount, recursiveCamLocs.Num()) : recursiveCamLocs.Num();
+	for (int i = deepestRecursion; i >= 0; i--)
 	{
 		// Update location of the scene capture.
-		FVector recursiveCamLoc = newCameraLocation;
-		FRotator recursiveCamRot = newCameraRotation;
-		for (int p = 0; p < i; p++)
+		FVector recursiveCamLoc = recursiveCamLocs[i];
+		FQuat recursiveCamRot = recursiveCamRots[i];
+		portalCapture->SetWorldLocationAndRotation(recursiveCamLoc, recursiveCamRot);
+
+		// Clip anything behind the target portal using the near plane of the projection matrix.
+		if (obliqueClipping)
 		{
-			recursiveCamLoc = ConvertLocationToPortal(recursiveCamLoc, this, pTargetPortal);
-			recursiveCamRot = ConvertRotationToPortal(recursiveCamRot, this, pTargetPortal);
+			FPlane viewClipPlane = FPortalMath::WorldPlaneToView(clipPlane, recursiveCamLoc, recursiveCamRot);
+			portalCapture->CustomProjectionMatrix = FPortalMath::MakeObliqueProjectionMatrix(projectionMatrix, viewClipPlane);
 		}
-		portalCapture->SetWorldLocationAndRotation(recursiveCamLoc, recursiveCamRot);
 
 		// Use-full for debugging convert transform to target function on the camera.
-		if (debugCameraTransform) DrawDebugBox(GetWorld(), recursiveCamLoc, FVector(10.0f), recursiveCamRot.Quaternion(), FColor::Red, false, 0.05f, 0.0f, 2.0f);
+		if (debugCameraTransform) DrawDebugBox(GetWorld(), recursiveCamLoc, FVector(10.0f), recursiveCamRot, FColor::Red, false, 0.05f, 0.0f, 2.0f);
 
-		// Set portal to not be rendered if its the first recursion event.
-		// NOTE: Caps off the end so theres no visual glitches.
-		if (i == recursionAmount) portalMesh->SetVisibility(false);
+		// Hide the portal from the capture if its the first recursion event.
+		// NOTE: Caps off the end so theres no visual glitches. Hidden from the capture only so its render state isn't recreated.
+		if (i == deepestRecursion) portalCapture->HiddenComponents.AddUnique(portalMesh);
 
 		// Update the portal scene capture to render it to the RT.
+		ApplyCaptureProfile(GetCaptureProfile(i));
 		portalCapture->CaptureScene();
 
 		// Set portal to be rendered for next recursion.
-		if (i == recursionAmount) portalMesh->SetVisibility(true);
+		if (i == deepestRecursion) portalCapture->HiddenComponents.Remove(portalMesh);
+	}
+
+	// The last capture from the cameras own view is what the render target keeps, including the depth its oblique near plane stored.
+	view.captureDepth[eye] = FPortalMath::GetDepthParameters(portalCapture->CustomProjectionMatrix);
+
+	// Show each portals own view again and give back the render targets used for the portals seen through this one.
+	for (APortal* swappedPortal : swappedPortals) swappedPortal->RestorePortalMaterialView();
+	for (UCanvasRenderTarget2D* borrowedTarget : borrowedTargets) portalManager->ReleaseRenderTarget(borrowedTarget);
+
+	// Remap the viewers screen UVs to the cropped capture.
+	// NOTE: The left eyes are restored after being used by the right eyes captures, mono views show the same capture in both eyes.
+	//       The first viewers material is restored after being used by another viewers captures.
+	SetMaterialEyeTexture(view.material, 0, view.renderTarget);
+	SetMaterialEyeTexture(view.material, 1, view.stereo ? view.renderTargetRight : view.renderTarget);
+	view.material->SetVectorParameterValue("PortalUVScaleBias", view.scaleBias[0]);
+	if (viewer != 0) RestorePortalMaterialView();
+	return true;
+}
+
+UCanvasRenderTarget2D* APortal::CaptureViewNode(int nodeIndex, const FVector& eyeLocation, const FQuat& eyeRotation, const FMatrix& projection,
+	FIntPoint size, TArray<APortal*>& swappedPortals, TArray<UCanvasRenderTarget2D*>& borrowedTargets)
+{
+	if (!initialised) return nullptr;
+
+	// Capture the portals seen through this one first.
+	const FPortalViewNode& node = portalManager->GetViewNode(nodeIndex);
+	for (int childNode : node.children)
+	{
+		APortal* childPortal = portalManager->GetViewNode(childNode).portal;
+		UCanvasRenderTarget2D* childTarget = childPortal->CaptureViewNode(childNode, eyeLocation, eyeRotation, projection, size, swappedPortals, borrowedTargets);
+		if (childTarget)
+		{
+			childPortal->SetPortalMaterialView(childTarget, FLinearColor(1.0f, 1.0f, 0.0f, 0.0f));
+			swappedPortals.AddUnique(childPortal);
+		}
+	}
+
+	// Borrow a render target for this frame.
+	UCanvasRenderTarget2D* nodeTarget = portalManager->AcquireRenderTarget(size);
+	if (!nodeTarget) return nullptr;
+	borrowedTargets.Add(nodeTarget);
+
+	// Capture from the view this portal is seen from converted through this portal.
+	FTransform captureTransform = node.viewTransform * GetTargetTransform().GetTransform();
+	FVector captureLoc = captureTransform.TransformPositionNoScale(eyeLocation);
+	FQuat captureRot = captureTransform.GetRotation() * eyeRotation;
+	FPlane clipPlane = UpdateCaptureClipPlane();
+	portalCapture->PostProcessSettings = portalManager->GetViewer(node.viewer).pawn->camera->PostProcessSettings;
+	portalCapture->HiddenComponents = portalManager->GetCaptureHiddenMeshes();
+	portalCapture->TextureTarget = nodeTarget;
+	portalCapture->bUseCustomProjectionMatrix = true;
+	portalCapture->CustomProjectionMatrix = projection;
+	if (obliqueClipping)
+	{
+		FPlane viewClipPlane = FPortalMath::WorldPlaneToView(clipPlane, captureLoc, captureRot);
+		portalCapture->CustomProjectionMatrix = FPortalMath::MakeObliqueProjectionMatrix(projection, viewClipPlane);
+	}
+	portalCapture->SetWorldLocationAndRotation(captureLoc, captureRot);
+	UpdateShowOnlyList();
+	ApplyCaptureProfile(GetCaptureProfile(node.depth));
+	portalCapture->CaptureScene();
+	return nodeTarget;
+}
+
+void APortal::ExecuteScheduledCapture()
+{
+	captureRequested = false;
+	UpdatePortalView();
+}
+
+float APortal::GetCapturePriority()
+{
+	// Portals covering more of the screen, closer and waiting longer go first. Portals with more recursions cost more so are pushed back.
+	// NOTE: Waiting time grows the priority without limit so deferred captures are never starved.
+	float coverage = 0.1f + lastScreenCoverage;
+	float waitingTime = GetWorld()->GetTimeSeconds() - lastUpdateTime;
+	float distance = GetClosestViewerDistance();
+	return coverage * (1.0f + waitingTime * 10.0f) / ((1.0f + distance / 1000.0f) * (1.0f + (lastCaptureCount - 1) * 0.25f));
+}
+
+void APortal::RecordCaptureCost(float milliseconds)
+{
+	averageCaptureCost = averageCaptureCost <= 0.0f ? milliseconds : FMath::Lerp(averageCaptureCost, milliseconds, 0.2f);
+}
+
+float APortal::GetAverageCaptureCost()
+{
+	return averageCaptureCost;
+}
+
+void APortal::SetMaterialEyeTexture(UMaterialInstanceDynamic* material, int eye, UTexture* texture)
+{
+	if (eye == 1)
+	{
+		material->SetTextureParameterValue("RT_RightEye", texture);
+		return;
+	}
+	material->SetTextureParameterValue("RT_Portal", texture);
+	material->SetTextureParameterValue("RT_LeftEye", texture);
+}
+
+void APortal::SetPortalMaterialView(UTexture* texture, const FLinearColor& scaleBias)
+{
+	SetMaterialEyeTexture(portalMaterial, 0, texture);
+	portalMaterial->SetVectorParameterValue("PortalUVScaleBias", scaleBias);
+}
+
+void APortal::RestorePortalMaterialView()
+{
+	bool hasView = views.Num() > 0;
+	SetMaterialEyeTexture(portalMaterial, 0, hasView ? GetShownPortalTexture(0, 0) : nullptr);
+	portalMaterial->SetVectorParameterValue("PortalUVScaleBias", hasView ? views[0].scaleBias[0] : FLinearColor(1.0f, 1.0f, 0.0f, 0.0f));
+}
+
+void APortal::UpdateReprojection()
+{
+	if (!initialised || !portalManager) return;
+	for (int viewer = 0; viewer < views.Num(); viewer++)
+	{
+		// Views captured this frame already show the current view.
+		FPortalView& view = views[viewer];
+		if (view.captureFrame == GFrameCounter || !view.material || !HasPortalTextures(viewer)) continue;
+		bool wasReprojected = view.reprojected[0] || view.reprojected[1];
+		bool reprojected = ReprojectPortalView(viewer, 0);
+		if (view.stereo) reprojected |= ReprojectPortalView(viewer, 1);
+		if (!reprojected && !wasReprojected) continue;
+
+		// Show each eyes warped capture, mono views show the same one in both eyes.
+		SetMaterialEyeTexture(view.material, 0, GetShownPortalTexture(viewer, 0));
+		SetMaterialEyeTexture(view.material, 1, GetShownPortalTexture(viewer, view.stereo ? 1 : 0));
+	}
+}
+
+bool APortal::ReprojectPortalView(int viewer, int eye)
+{
+	FPortalView& view = views[viewer];
+	view.reprojected[eye] = false;
+	UCanvasRenderTarget2D* eyeRenderTarget = GetPortalTexture(viewer, eye);
+	if (!reprojectStaleCaptures || !eyeRenderTarget || !FPortalReprojection::IsSupported(GetWorld()->FeatureLevel)) return false;
+
+	// Get the viewers current view through the portal for this eye.
+	const FPortalViewer& portalViewer = portalManager->GetViewer(viewer);
+	EStereoscopicPass pass = !view.stereo ? EStereoscopicPass::eSSP_FULL : eye == 1 ? EStereoscopicPass::eSSP_RIGHT_EYE : EStereoscopicPass::eSSP_LEFT_EYE;
+	FSceneViewProjectionData projectionData;
+	if (!portalViewer.player->GetCameraProjectionData(pass, projectionData)) return false;
+	FPortalTransform& portalTransform = GetTargetTransform();
+	FVector currentLoc = portalTransform.TransformLocation(projectionData.ViewOrigin);
+	FQuat currentRot = portalTransform.TransformRotation(portalViewer.pawn->camera->GetComponentQuat());
+
+	// Nothing to warp while the view hasn't moved since it was captured.
+	if (currentLoc.Equals(view.captureViewLoc[eye], 0.01f) && currentRot.Equals(view.captureViewRot[eye], 1.e-5f)) return false;
+
+	// Warp into the captures cropped screen space so the material samples it with the same scale and bias.
+	// NOTE: Parts of the portal outside of the captures bounds stretch from its edges until the next capture.
+	FMatrix currentProjection = FPortalMath::CropProjectionMatrix(projectionData.ProjectionMatrix, view.captureBounds[eye]);
+	FMatrix currentViewProjection = FPortalMath::MakeViewProjectionMatrix(currentLoc, currentRot, currentProjection);
+	FMatrix reprojection = FPortalMath::MakeReprojectionMatrix(view.captureViewLoc[eye], view.captureViewRot[eye], currentViewProjection);
+
+	// Borrow a render target the same size as the capture to warp into. NOTE: Capture sizes are already bucketed so the pool returns the same size.
+	UCanvasRenderTarget2D*& eyeReprojectedTarget = eye == 1 ? view.reprojectedTargetRight : view.reprojectedTarget;
+	if (eyeReprojectedTarget && (eyeReprojectedTarget->SizeX != eyeRenderTarget->SizeX || eyeReprojectedTarget->SizeY != eyeRenderTarget->SizeY))
+	{
+		portalManager->ReleaseRenderTarget(eyeReprojectedTarget);
+		eyeReprojectedTarget = nullptr;
+	}
+	if (!eyeReprojectedTarget) eyeReprojectedTarget = portalManager->AcquireRenderTarget(FIntPoint(eyeRenderTarget->SizeX, eyeRenderTarget->SizeY));
+	if (!eyeReprojectedTarget) return false;
+
+	FPortalReprojection::Reproject(eyeRenderTarget, eyeReprojectedTarget, reprojection, view.captureUnproject[eye], view.captureDepth[eye], GetWorld()->FeatureLevel);
+	view.reprojected[eye] = true;
+	return true;
+}
+
+FPortalCaptureProfile APortal::GetCaptureProfile(int recursion) const
+{
+	if (captureProfiles.Num() == 0) return FPortalCaptureProfile();
+	if (captureProfiles.IsValidIndex(recursion)) return captureProfiles[recursion];
+
+	// Past the last profile so keep lowering the LOD detail for each extra recursion.
+	FPortalCaptureProfile profile = captureProfiles.Last();
+	profile.lodDistanceFactor *= FMath::Pow(1.5f, recursion - (captureProfiles.Num() - 1));
+	return profile;
+}
+
+void APortal::ApplyCaptureProfile(const FPortalCaptureProfile& profile)
+{
+	portalCapture->ShowFlags.SetDynamicShadows(profile.shadows);
+	portalCapture->ShowFlags.SetPointLights(profile.dynamicLights);
+	portalCapture->ShowFlags.SetSpotLights(profile.dynamicLights);
+	portalCapture->ShowFlags.SetRectLights(profile.dynamicLights);
+	portalCapture->ShowFlags.SetTranslucency(profile.translucency);
+	portalCapture->ShowFlags.SetPostProcessing(profile.postProcess);
+	portalCapture->PostProcessBlendWeight = profile.postProcess ? 1.0f : 0.0f;
+	portalCapture->LODDistanceFactor = profile.lodDistanceFactor;
+	portalCapture->MaxViewDistanceOverride = profile.maxViewDistance > 0.0f ? profile.maxViewDistance : -1.0f;
+}
+
+void APortal::UpdateShowOnlyList()
+{
+	if (!useShowOnlyList)
+	{
+		portalCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_RenderScenePrimitives;
+		portalCapture->ShowOnlyComponents.Reset();
+		numStaticShowOnly = 0;
+		showOnlySceneVersion = -1;
+		return;
+	}
+	portalCapture->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
+
+	// Anything visible through the portal is in front of the target portal.
+	FTransform targetPortalTransform = pTargetPortal->portalMesh->GetComponentTransform();
+	FVector targetLocation = targetPortalTransform.GetLocation();
+	FPlane targetPlane = FPlane(targetLocation, pTargetPortal->portalMesh->GetForwardVector());
+
+	// Only primitives near the target portal need checking. NOTE: Found from the portal managers primitive grids shared by every portal.
+	FBox searchBox = FBox(FVector(-HALF_WORLD_MAX), FVector(HALF_WORLD_MAX));
+	if (destinationViewDistance > 0.0f) searchBox = FBox(targetLocation - FVector(destinationViewDistance), targetLocation + FVector(destinationViewDistance));
+	TArray<UPrimitiveComponent*> nearbyPrimitives;
+
+	// Find the non-movable primitives again if the target portal has moved or levels have changed.
+	if (showOnlySceneVersion != portalManager->GetSceneVersion() || !targetPortalTransform.Equals(showOnlyTargetTransform, 0.0f))
+	{
+		showOnlySceneVersion = portalManager->GetSceneVersion();
+		showOnlyTargetTransform = targetPortalTransform;
+		portalCapture->ShowOnlyComponents.Reset();
+		portalManager->GetStaticPrimitives().Query(searchBox, nearbyPrimitives);
+		for (UPrimitiveComponent* primitive : nearbyPrimitives)
+		{
+			if (IsInDestinationView(primitive, targetPlane, targetLocation)) portalCapture->ShowOnlyComponents.Add(primitive);
+		}
+
+		// This portal must always be rendered for recursion.
+		portalCapture->ShowOnlyComponents.AddUnique(portalMesh);
+		numStaticShowOnly = portalCapture->ShowOnlyComponents.Num();
+	}
+
+	// Re-check the dynamic primitives near the target portal after the non-movable primitives.
+	portalCapture->ShowOnlyComponents.SetNum(numStaticShowOnly, false);
+	nearbyPrimitives.Reset();
+	portalManager->GetDynamicPrimitives().Query(searchBox, nearbyPrimitives);
+	for (UPrimitiveComponent* primitive : nearbyPrimitives)
+	{
+		if (IsInDestinationView(primitive, targetPlane, targetLocation)) portalCapture->ShowOnlyComponents.Add(primitive);
+	}
+}
+
+bool APortal::IsInDestinationView(const UPrimitiveComponent* primitive, const FPlane& targetPlane, const FVector& targetLocation) const
+{
+	if (!primitive || !primitive->IsRegistered()) return false;
+
+	// Bounds must be in front of the target portal and within the view distance.
+	const FBoxSphereBounds& bounds = primitive->Bounds;
+	if (targetPlane.PlaneDot(bounds.Origin) < -bounds.SphereRadius) return false;
+	if (destinationViewDistance > 0.0f && FVector::Dist(bounds.Origin, targetLocation) - bounds.SphereRadius > destinationViewDistance) return false;
+	return true;
+}
+
+bool APortal::IsCaptureCached()
+{
+	for (int viewer = 0; viewer < views.Num(); viewer++)
+	{
+		if (!IsViewCached(viewer)) return false;
+	}
+	return views.Num() > 0;
+}
+
+bool APortal::IsViewCached(int viewer)
+{
+	// Nothing to reuse or the cached view is too old.
+	FPortalView& view = views[viewer];
+	if (!cacheCaptures || !view.cached || !HasPortalTextures(viewer)) return false;
+	if (GetWorld()->GetTimeSeconds() - view.lastCaptureTime > captureCacheMaxAge) return false;
+
+	// Has the view moved relative to the portals. NOTE: Compared at the target so either portal moving also counts.
+	const FPortalViewer& portalViewer = portalManager->GetViewer(viewer);
+	FPortalTransform& portalTransform = GetTargetTransform();
+	UCameraComponent* playerCamera = portalViewer.pawn->camera;
+	FVector captureLoc = portalTransform.TransformLocation(playerCamera->GetComponentLocation());
+	FQuat captureRot = portalTransform.TransformRotation(playerCamera->GetComponentQuat());
+	if (!captureLoc.Equals(view.lastCaptureLoc, 0.01f) || !captureRot.Equals(view.lastCaptureRot, 1.e-5f)) return false;
+
+	// Has the projection changed, from the FOV or the viewport being resized.
+	FIntPoint viewportSize;
+	portalViewer.controller->GetViewportSize(viewportSize.X, viewportSize.Y);
+	if (viewportSize != view.lastViewportSize || !portalViewer.player->GetCameraProjectionMatrix().Equals(view.lastCaptureProjection, 0.0f)) return false;
+
+	// Has anything that can be seen through the portal moved or started animating.
+	// NOTE: Only queried once the view hasn't changed and at most once a frame for every viewer.
+	bool animated = false;
+	uint32 destinationHash = GetDestinationHash(animated);
+	return !animated && destinationHash == view.lastDestinationHash;
+}
+
+uint32 APortal::GetDestinationHash(bool& outAnimated)
+{
+	// The scene in front of the target portal is the same for every viewer so only find it once a frame.
+	if (destinationHashFrame == GFrameCounter)
+	{
+		outAnimated = frameDestinationAnimated;
+		return frameDestinationHash;
+	}
+	outAnimated = false;
+
+	// Find everything that can move in front of the target portal from the portal managers dynamic primitives.
+	// NOTE: Includes primitives without collision such as particles, visual only movers and attachments.
+	FTransform targetPortalTransform = pTargetPortal->portalMesh->GetComponentTransform();
+	targetPortalTransform.RemoveScaling();
+	FVector boxExtent = FVector(captureCacheDistance * 0.5f, captureCacheDistance, captureCacheDistance);
+	FTransform boxTransform = FTransform(targetPortalTransform.GetRotation(), targetPortalTransform.TransformPositionNoScale(FVector(boxExtent.X, 0.0f, 0.0f)));
+	FBox searchBox = FBox(-boxExtent, boxExtent).TransformBy(boxTransform);
+	TArray<UPrimitiveComponent*> nearbyPrimitives;
+	portalManager->GetDynamicPrimitives().Query(searchBox, nearbyPrimitives);
+
+	// Sum each primitives hash so the order the primitives are found in doesn't matter.
+	uint32 destinationHash = 0;
+	for (UPrimitiveComponent* primitive : nearbyPrimitives)
+	{
+		if (!primitive->IsVisible() || !FPortalMath::OverlapsOrientedBox(boxTransform, boxExtent, primitive->Bounds.Origin, primitive->Bounds.BoxExtent)) continue;
+
+		// Animation and particle simulation don't move the component so they're always treated as changed.
+		USkeletalMeshComponent* skeletalMesh = Cast<USkeletalMeshComponent>(primitive);
+		UParticleSystemComponent* particles = Cast<UParticleSystemComponent>(primitive);
+		bool animating = skeletalMesh && !skeletalMesh->bPauseAnims && skeletalMesh->IsComponentTickEnabled();
+		bool simulating = particles && particles->IsActive() && particles->IsComponentTickEnabled();
+		if (animating || simulating)
+		{
+			outAnimated = true;
+			destinationHash = 0;
+			break;
+		}
+
+		FVector location = primitive->GetComponentLocation();
+		FQuat rotation = primitive->GetComponentQuat();
+		uint32 primitiveHash = PointerHash(primitive);
+		primitiveHash = FCrc::MemCrc32(&location, sizeof(FVector), primitiveHash);
+		primitiveHash = FCrc::MemCrc32(&rotation, sizeof(FQuat), primitiveHash);
+		destinationHash += primitiveHash;
+	}
+	destinationHashFrame = GFrameCounter;
+	frameDestinationHash = destinationHash;
+	frameDestinationAnimated = outAnimated;
+	return destinationHash;
+}
+
+int APortal::GetSkippedCaptureCount()
+{
+	return skippedCaptures;
+}
+
+float APortal::GetLastUpdateTime()
+{
+	return lastUpdateTime;
+}
+
+bool APortal::IsUpdateDue()
+{
+	// Always update straight away after being activated or if there's no view to show.
+	if (currentFrameCount == 0 || !HasPortalTextures()) return true;
+
+	// Find the number of frames between updates.
+	int frameInterval = 1;
+	switch (updateRate)
+	{
+	case EPortalUpdateRate::EVERYFRAME:
+		return true;
+	case EPortalUpdateRate::FRAMES:
+		frameInterval = FMath::Max(updateFrameInterval, 1);
+		break;
+	case EPortalUpdateRate::TIME:
+	{
+		// Offset the time each portal updates by a fraction of the interval.
+		float interval = FMath::Max(updateTimeInterval, 1.0f) * 0.001f;
+		float phaseOffset = FMath::Frac(updatePhase * 0.618034f) * interval;
+		float currentTime = GetWorld()->GetTimeSeconds();
+		return FMath::FloorToInt((currentTime + phaseOffset) / interval) != FMath::FloorToInt((lastUpdateTime + phaseOffset) / interval);
+	}
+	case EPortalUpdateRate::AUTOMATIC:
+	{
+		// Pick a rate from the distance to the closest viewer and the last known coverage on screen.
+		float distance = GetClosestViewerDistance();
+		if (distance <= fullRateDistance || lastScreenCoverage >= fullRateCoverage) return true;
+		frameInterval = distance <= halfRateDistance ? 2 : 4;
+		break;
 	}
+	}
+
+	// Offset the frame each portal updates on.
+	return (GFrameCounter + updatePhase) % frameInterval == 0;
 }
 
 void APortal::UpdateWorldOffset()
 {
-	// If the camera is within the portal box.
-	if (LocationInsidePortal(portalPawn->camera->GetComponentLocation()))
+	// Each viewer only sees its own view so offset the ones whose camera is within the portal box.
+	for (int viewer = 0; viewer < views.Num(); viewer++)
 	{
-		portalMaterial->SetScalarParameterValue("ScaleOffset", 1.0f);
+		UCameraComponent* playerCamera = GetViewerCamera(viewer);
+		bool inside = playerCamera && LocationInsidePortal(playerCamera->GetComponentLocation());
+		views[viewer].material->SetScalarParameterValue("ScaleOffset", inside ? 1.0f : 0.0f);
 	}
-	else
+}
+
+float APortal::GetClosestViewerDistance()
+{
+	float closest = BIG_NUMBER;
+	int numViewers = portalManager ? portalManager->GetNumViewers() : 0;
+	for (int viewer = 0; viewer < numViewers; viewer++)
 	{
-		portalMaterial->SetScalarParameterValue("ScaleOffset", 0.0f);
+		if (UCameraComponent* playerCamera = GetViewerCamera(viewer))
+		{
+			closest = FMath::Min(closest, GetDistanceToPortal(playerCamera->GetComponentLocation()));
+		}
 	}
+	return closest;
+}
+
+UCameraComponent* APortal::GetViewerCamera(int viewer) const
+{
+	if (!portalManager || viewer < 0 || viewer >= portalManager->GetNumViewers()) return nullptr;
+	APortalPawn* pawn = portalManager->GetViewer(viewer).pawn;
+	return pawn && !pawn->IsPendingKill() ? pawn->camera : nullptr;
 }
 
 void APortal::UpdatePawnTracking()
 {
-	// Check for when the pawn has passed through this portal between frames.
-	FVector currLocation = portalPawn->camera->GetComponentLocation();
-	if (currLocation.ContainsNaN()) return;
-	FVector pointInterscetion;
-	FPlane portalPlane = FPlane(portalMesh->GetComponentLocation(), portalMesh->GetForwardVector());
-	bool passedThroughPlane = FMath::SegmentPlaneIntersection(lastPawnLoc, currLocation, portalPlane, pointInterscetion);
-	FVector relativeIntersection = portalMesh->GetComponentTransform().InverseTransformPositionNoScale(pointInterscetion);
+	FTransform aperture = portalMesh->GetComponentTransform();
 	FVector portalSize = portalBox->GetScaledBoxExtent();// NOTE: Ensure portal box is setup correctly for this to work.
-	bool passedWithinPortal = FMath::Abs(relativeIntersection.Z) <= portalSize.Z &&
-							  FMath::Abs(relativeIntersection.Y) <= portalSize.Y;
-
-	// If the pawn has passed through the plane within the portals boundaries teleport.
-	// Make sure the pawn has passed through the portal the correct way before teleporting.
-	if (passedThroughPlane && passedWithinPortal && IsInfront(lastPawnLoc))
+	FVector2D apertureExtent = FVector2D(portalSize.Y, portalSize.Z);
+	for (int viewer = 0; viewer < views.Num(); viewer++)
 	{
-		// Teleport the actor.
-		TeleportObject(portalPawn);
-	}
+		// Check for when the viewers pawn has passed through this portal between frames.
+		UCameraComponent* playerCamera = GetViewerCamera(viewer);
+		if (!playerCamera) continue;
+		FPortalView& view = views[viewer];
+		FVector currLocation = playerCamera->GetComponentLocation();
+		if (currLocation.ContainsNaN()) continue;
+
+		// If the pawn has passed through the plane within the portals boundaries teleport.
+		// Make sure the pawn has passed through the portal the correct way before teleporting.
+		// NOTE: Only the camera needs to be within the portal as it is what sees through it.
+		float timeOfImpact;
+		if (FPortalMath::SweepThroughAperture(aperture, apertureExtent, view.lastPawnLoc, currLocation, FVector::ZeroVector, timeOfImpact))
+		{
+			// Teleport the actor. NOTE: Updates the last pawn location at the target portal.
+			TeleportObject(portalManager->GetViewer(viewer).pawn);
+		}
 
-	// Last pawn location.
-	lastPawnLoc = portalPawn->camera->GetComponentLocation();
+		// Last pawn location. NOTE: The view may have been removed if the teleport changed the viewers.
+		if (views.IsValidIndex(viewer)) views[viewer].lastPawnLoc = playerCamera->GetComponentLocation();
+	}
 }
 
-void APortal::UpdateTrackedActors()
+void APortal::GatherTrackedActors(FTrackedActorsUpdate& outUpdate, int32 first, int32 num) const
 {
-	// Loop through all tracked actors. Key is the actor and Value is the tracking structure.
-	if (actorsBeingTracked > 0)
+	outUpdate.Reset();
+	if (num <= 0) return;
+
+	// Find the positions for the duplicate tracked actors at the target portal. NOTE: Only if it isn't null.
+	// NOTE: Gathered first so they can all be converted to the target portal in one batch.
+	FTransform aperture = portalMesh->GetComponentTransform();
+	FVector portalSize = portalBox->GetScaledBoxExtent();// NOTE: Ensure portal box is setup correctly for this to work.
+	FVector2D apertureExtent = FVector2D(portalSize.Y, portalSize.Z);
+	for (int i = first; i < first + num; i++)
 	{
-		TArray<AActor*> teleportedActors;
-		for (TMap<AActor*, FTrackedActor>::TIterator trackedActor = trackedActors.CreateIterator(); trackedActor; ++trackedActor)
+		AActor* trackedActor = trackedActors.actors[i];
+		AActor* isValid = trackedActors.duplicates[i];
+		if (isValid && isValid->IsValidLowLevel())
 		{
-			// Update the positions for the duplicate tracked actors at the target portal. NOTE: Only if it isn't null.
-			AActor* isValid = trackedActor->Value.trackedDuplicate;
-			if (isValid && isValid->IsValidLowLevel())
+			outUpdate.duplicates.Add(isValid);
+			outUpdate.duplicateLocs.Add(trackedActor->GetActorLocation());
+			outUpdate.duplicateRots.Add(trackedActor->GetActorQuat());
+		}
+		else if (trackedActors.instancers[i] != INDEX_NONE)
+		{
+			outUpdate.instances.Add(FIntPoint(trackedActors.instancers[i], trackedActors.instances[i]));
+			outUpdate.instanceLocs.Add(trackedActor->GetActorLocation());
+			outUpdate.instanceRots.Add(trackedActor->GetActorQuat());
+			outUpdate.instanceScales.Add(trackedActor->GetActorScale3D());
+		}
+
+		// If its the player skip this next part as its handled in UpdatePawnTracking.
+		// NOTE: Still want to track the actor and position duplicate mesh...
+		if (APortalPawn* isPlayer = Cast<APortalPawn>(trackedActor)) continue;
+
+		// Bodies tested in the physics substeps have already been teleported if they crossed.
+		// NOTE: Otherwise only the motion since the last substep is left to check.
+		FVector lastOrigin = trackedActors.lastOrigins[i];
+		int32 substepIndex = trackedActors.substepIndices[i];
+		if (substepIndex != INDEX_NONE && substepBodies.IsValidIndex(substepIndex))
+		{
+			const FSubstepBody& substepBody = substepBodies[substepIndex];
+			if (substepBody.crossedTime >= 0.0f)
 			{
-				FVector convertedLoc = ConvertLocationToPortal(trackedActor->Key->GetActorLocation(), this, pTargetPortal);
-				FRotator convertedRot = ConvertRotationToPortal(trackedActor->Key->GetActorRotation(), this, pTargetPortal);
-				isValid->SetActorLocationAndRotation(convertedLoc, convertedRot); 
+				outUpdate.crossedActors.Add(trackedActors.GetHandle(i));
+				outUpdate.crossedTimes.Add(substepBody.crossedTime / FMath::Max(substepBody.elapsedTime, SMALL_NUMBER));
+				outUpdate.crossedInSubstep.Add(true);
+				continue;
 			}
+			lastOrigin = substepBody.lastOrigin;
+		}
 
-			// If its the player skip this next part as its handled in UpdatePawnTracking.
-			// NOTE: Still want to track the actor and position duplicate mesh...
-			if (APortalPawn* isPlayer = Cast<APortalPawn>(trackedActor->Key)) continue;
+		// Check for when the actors origin passes through the portal between frames while its bounds are within the portal.
+		// NOTE: Swept so fast actors are caught at any frame rate without passing through the wall around the portal.
+		USceneComponent* trackedComp = trackedActors.components[i];
+		FVector currLocation = trackedComp->GetComponentLocation();
+		float timeOfImpact;
+		if (FPortalMath::SweepThroughAperture(aperture, apertureExtent, lastOrigin, currLocation, trackedComp->Bounds.BoxExtent, timeOfImpact))
+		{
+			outUpdate.crossedActors.Add(trackedActors.GetHandle(i));
+			outUpdate.crossedTimes.Add(timeOfImpact);
+			outUpdate.crossedInSubstep.Add(false);
+		}
+		else outUpdate.trackedOrigins.Add(TPair<FTrackedActorHandle, FVector>(trackedActors.GetHandle(i), currLocation));
+	}
+	const FPortalTransform& portalTransform = targetTransform;
+	portalTransform.TransformLocations(outUpdate.duplicateLocs.GetData(), outUpdate.duplicateLocs.GetData(), outUpdate.duplicateLocs.Num());
+	portalTransform.TransformRotations(outUpdate.duplicateRots.GetData(), outUpdate.duplicateRots.GetData(), outUpdate.duplicateRots.Num());
+	portalTransform.TransformLocations(outUpdate.instanceLocs.GetData(), outUpdate.instanceLocs.GetData(), outUpdate.instanceLocs.Num());
+	portalTransform.TransformRotations(outUpdate.instanceRots.GetData(), outUpdate.instanceRots.GetData(), outUpdate.instanceRots.Num());
+}
 
-			// Check for when the actors origin passes to the other side of the portal between frames.
-			FVector currLocation = trackedActor->Value.trackedComp->GetComponentLocation();
-			FVector pointInterscetion;
-			FPlane portalPlane = FPlane(portalMesh->GetComponentLocation(), portalMesh->GetForwardVector());
-			bool passedThroughPortal = FMath::SegmentPlaneIntersection(trackedActor->Value.lastTrackedOrigin, currLocation, portalPlane, pointInterscetion);
-			if (passedThroughPortal)
-			{
-				// Teleport the actor.
-				// NOTE: If actor is simulating physics and has 
-				// CCD it will effect physics objects around it when moved.
-				TeleportObject(trackedActor->Key);
+void APortal::ApplyTrackedActors(const FTrackedActorsUpdate& update)
+{
+	// Move the duplicates to their tracked actors at the target portal.
+	for (int i = 0; i < update.duplicates.Num(); i++)
+	{
+		update.duplicates[i]->SetActorLocationAndRotation(update.duplicateLocs[i], update.duplicateRots[i]);
+	}
 
-				// Add to be removed.
-				teleportedActors.Add(trackedActor->Key);
+	// Move the duplicate instances. NOTE: Sent to their instanced meshes in one batch when the portal manager flushes the target portal.
+	for (int i = 0; i < update.instances.Num(); i++)
+	{
+		const FIntPoint& instance = update.instances[i];
+		if (!pTargetPortal->duplicateInstancers.IsValidIndex(instance.X)) continue;
+		FTransform instanceTransform = FTransform(update.instanceRots[i], update.instanceLocs[i], update.instanceScales[i]);
+		pTargetPortal->duplicateInstancers[instance.X].SetInstanceTransform(instance.Y, instanceTransform);
+	}
 
-				// Skip to next actor once removed.
-				continue;
-			}
+	// Update last tracked origin for the actors that haven't crossed.
+	// NOTE: Found by handle as another portals teleport may have changed the tracked actors since they were gathered.
+	for (const TPair<FTrackedActorHandle, FVector>& trackedOrigin : update.trackedOrigins)
+	{
+		int32 index = trackedActors.GetIndex(trackedOrigin.Key);
+		if (index != INDEX_NONE) trackedActors.lastOrigins[index] = trackedOrigin.Value;
+	}
 
-			// Update last tracked origin.
-			trackedActor->Value.lastTrackedOrigin = currLocation;
+	if (update.crossedActors.Num() > 0)
+	{
+		TArray<AActor*> teleportedActors;
+		for (int i = 0; i < update.crossedActors.Num(); i++)
+		{
+			int32 index = trackedActors.GetIndex(update.crossedActors[i]);
+			if (index == INDEX_NONE) continue;
+			AActor* actor = trackedActors.actors[index];
+			if (debugTrackedActors) UE_LOG(LogPortal, Log, TEXT("Tracked actor %s crossed %.2f through the frame."), *actor->GetName(), update.crossedTimes[i]);
+
+			// Teleport the actor from where it ended the frame. NOTE: The time of impact isn't needed to place it as the portal transform is
+			//       rigid, the end position converted through the portal is where the rest of the frames motion from the crossing point
+			//       would have taken it at the target. Only collisions at the target during that part of the frame are missed, which is
+			//       what substepCrossings is for.
+			// NOTE: If actor is simulating physics and has 
+			// CCD it will effect physics objects around it when moved.
+			TeleportObject(actor, update.crossedInSubstep[i]);
+
+			// Add to be removed.
+			teleportedActors.Add(actor);
 		}
 
 		// Ensure the tracked actor has been removed.
@@ -474,141 +1425,279 @@ void APortal::UpdateTrackedActors()
 			if (!actor || !actor->IsValidLowLevelFast()) continue;
 			if (trackedActors.Contains(actor)) RemoveTrackedActor(actor);
 			if (!pTargetPortal->trackedActors.Contains(actor)) pTargetPortal->AddTrackedActor(actor);
-			if (AActor* hasDuplicate = pTargetPortal->trackedActors.FindRef(actor).trackedDuplicate) HideActor(hasDuplicate, false);
+			pTargetPortal->HideDuplicate(actor, false);
 		}
 	}	
 }
 
-void APortal::TeleportObject(AActor* actor)
+void APortal::TeleportObject(AActor* actor, bool teleportedInSubstep)
 {
 	// Return if object is null.
 	if (actor == nullptr) return;
 
 	// Perform a camera cut so the teleportation is seamless with the render functions.
-	UPortalPlayer* portalPlayer = Cast<UPortalPlayer>(portalController->GetLocalPlayer());
-	CHECK_DESTROY(LogPortal, !portalPlayer, "TeleportObject: Portal player class couldnt be found in the portal %s.", *GetName());
-	portalPlayer->CameraCut();
+	// NOTE: Only the teleported pawns player needs a cut, any other actor may be seen by every viewer.
+	APortalPawn* teleportedPawn = Cast<APortalPawn>(actor);
+	int numViewers = portalManager ? portalManager->GetNumViewers() : 0;
+	for (int viewer = 0; viewer < numViewers; viewer++)
+	{
+		const FPortalViewer& portalViewer = portalManager->GetViewer(viewer);
+		if (!teleportedPawn || portalViewer.pawn == teleportedPawn) portalViewer.player->CameraCut();
+	}
 
 	// Teleport the physics object. Teleport both position and relative velocity.
-	UPrimitiveComponent* primComp = Cast<UPrimitiveComponent>(actor->GetRootComponent());
-	FVector newLinearVelocity = ConvertDirectionToTarget(primComp->GetPhysicsLinearVelocity());
-	FVector newAngularVelocity = ConvertDirectionToTarget(primComp->GetPhysicsAngularVelocityInDegrees());
-	FVector convertedLoc = ConvertLocationToPortal(actor->GetActorLocation(), this, pTargetPortal);
-	FRotator convertedRot = ConvertRotationToPortal(actor->GetActorRotation(), this, pTargetPortal);
-	primComp->SetWorldLocationAndRotation(convertedLoc, convertedRot, false, nullptr, ETeleportType::TeleportPhysics);
-	primComp->SetPhysicsLinearVelocity(newLinearVelocity);
-	primComp->SetPhysicsAngularVelocityInDegrees(newAngularVelocity);
+	// NOTE: A body teleported in a substep has already been moved and synced back to its component.
+	if (!teleportedInSubstep)
+	{
+		UPrimitiveComponent* primComp = Cast<UPrimitiveComponent>(actor->GetRootComponent());
+		FPortalTransform& portalTransform = GetTargetTransform();
+		FVector newLinearVelocity = portalTransform.TransformDirection(primComp->GetPhysicsLinearVelocity());
+		FVector newAngularVelocity = portalTransform.TransformDirection(primComp->GetPhysicsAngularVelocityInDegrees());
+		FVector convertedLoc = portalTransform.TransformLocation(actor->GetActorLocation());
+		FQuat convertedRot = portalTransform.TransformRotation(actor->GetActorQuat());
+		primComp->SetWorldLocationAndRotation(convertedLoc, convertedRot, false, nullptr, ETeleportType::TeleportPhysics);
+		primComp->SetPhysicsLinearVelocity(newLinearVelocity);
+		primComp->SetPhysicsAngularVelocityInDegrees(newAngularVelocity);
+	}
 
 	// If its a player handle any extra teleporting functionality in the player class.
-	if (APortalPawn* isPawn = Cast<APortalPawn>(actor))
+	if (teleportedPawn)
 	{
-		isPawn->PortalTeleport(pTargetPortal);
-		portalPawn->ReleaseInteractable();
+		teleportedPawn->PortalTeleport(pTargetPortal);
+		teleportedPawn->ReleaseInteractable();
 	}
 	else
 	{
-		// If the actor is grabbed by the pawn update the offset after teleporting.
-		if (UPrimitiveComponent* isGrabbing = portalPawn->physicsHandle->GetGrabbedComponent())
+		// If the actor is grabbed by any of the viewers pawns update the offset after teleporting.
+		for (int viewer = 0; viewer < numViewers; viewer++)
 		{
-			if (isGrabbing == (UPrimitiveComponent*)actor->GetRootComponent())
+			APortalPawn* viewerPawn = portalManager->GetViewer(viewer).pawn;
+			if (!viewerPawn) continue;
+			if (UPrimitiveComponent* isGrabbing = viewerPawn->physicsHandle->GetGrabbedComponent())
 			{
-				portalPawn->ReleaseInteractable();
+				if (isGrabbing == (UPrimitiveComponent*)actor->GetRootComponent())
+				{
+					viewerPawn->ReleaseInteractable();
+				}
 			}
 		}
 	}
 
 	// Update the portal view and world offset for the target portal.
+	pTargetPortal->UpdateViews();
 	pTargetPortal->UpdateWorldOffset();
-	pTargetPortal->UpdatePortalView();
-	pTargetPortal->lastPawnLoc = portalPawn->camera->GetComponentLocation();
-
-	// Make sure the duplicate created is not hidden after teleported.
-	if (pTargetPortal->trackedActors.Contains(actor))
+	if (portalManager->scheduleCaptures)
 	{
-		if (AActor* hasDuplicate = pTargetPortal->trackedActors.FindRef(actor).trackedDuplicate)
+		pTargetPortal->captureRequested = true;
+		portalManager->RequestCapture(pTargetPortal, true);
+	}
+	else pTargetPortal->UpdatePortalView();
+	for (int viewer = 0; viewer < pTargetPortal->views.Num(); viewer++)
+	{
+		if (UCameraComponent* playerCamera = pTargetPortal->GetViewerCamera(viewer))
 		{
-			HideActor(hasDuplicate, false);
+			pTargetPortal->views[viewer].lastPawnLoc = playerCamera->GetComponentLocation();
 		}
 	}
+
+	// Make sure the duplicate created is not hidden after teleported.
+	pTargetPortal->HideDuplicate(actor, false);
 }
 
-void APortal::DeleteCopy(AActor* actorToDelete)
+void APortal::QueueSubstepCrossings()
 {
-	// Destroy visual copy of the tracked actor.
-	// NOTE: Put a few checks in here because at high velocities destroyActor was becoming invalid.
-	if (trackedActors.Contains(actorToDelete))
+	// Clear last frames substep bodies. NOTE: Their callbacks have already ran in the last physics step.
+	for (int i = 0; i < substepBodies.Num(); i++)
 	{
-		// Ensure actor is valid...
-		// NOTE: Keeps throwing errors when destroying actor on a null error. Running out of ways to check it is valid before destruction?...
-		if (AActor* isValid = trackedActors.FindRef(actorToDelete).trackedDuplicate)
-		{
-			// Also remove from duplicate map.
-			duplicateMap.Remove(isValid);
+		int32 index = trackedActors.GetIndex(substepBodies[i].handle);
+		if (index != INDEX_NONE) trackedActors.substepIndices[index] = INDEX_NONE;
+	}
+	substepBodies.Reset();
+	if (!substepCrossings || !UPhysicsSettings::Get()->bSubstepping || !active || !pTargetPortal || trackedActors.Num() == 0) return;
 
-			// Destroy if it has not begun its destruction process.
-			if (isValid->IsValidLowLevel() && !isValid->IsPendingKillOrUnreachable() && !isValid->IsPendingKillPending())
-			{
-				// If world is valid.
-				if (UWorld* world = GetWorld())
-				{
-					world->DestroyActor(isValid);
-					isValid = nullptr;
-					world->ForceGarbageCollection();
-				}
-			}
-		}
+	// Snapshot the portal for the substeps as they can run off the game thread.
+	substepAperture = portalMesh->GetComponentTransform();
+	FVector portalSize = portalBox->GetScaledBoxExtent();
+	substepApertureExtent = FVector2D(portalSize.Y, portalSize.Z);
+	substepToTarget = GetTargetTransform().GetTransform();
+
+	// Add a substep callback for every simulating tracked body. NOTE: Pawns are tracked by their camera in UpdatePawnTracking.
+	for (int i = 0; i < trackedActors.Num(); i++)
+	{
+		if (trackedActors.actors[i]->IsA<APortalPawn>()) continue;
+		UPrimitiveComponent* primComp = Cast<UPrimitiveComponent>(trackedActors.components[i]);
+		FBodyInstance* bodyInstance = primComp ? primComp->GetBodyInstance() : nullptr;
+		if (!bodyInstance || !primComp->IsSimulatingPhysics()) continue;
+		int32 substepIndex = substepBodies.AddDefaulted();
+		FSubstepBody& substepBody = substepBodies[substepIndex];
+		substepBody.handle = trackedActors.GetHandle(i);
+		substepBody.lastOrigin = primComp->GetComponentLocation();
+		substepBody.boxExtent = primComp->Bounds.BoxExtent;
+		trackedActors.substepIndices[i] = substepIndex;
+		FCalculateCustomPhysics onSubstep = FCalculateCustomPhysics::CreateUObject(this, &APortal::SubstepTrackedBody, substepIndex);
+		bodyInstance->AddCustomPhysics(onSubstep);
+	}
+}
+
+void APortal::SubstepTrackedBody(float DeltaTime, FBodyInstance* bodyInstance, int32 substepIndex)
+{
+	if (!substepBodies.IsValidIndex(substepIndex)) return;
+	FSubstepBody& substepBody = substepBodies[substepIndex];
+	float lastStartTime = substepBody.elapsedTime - substepBody.lastDeltaTime;
+	float lastDeltaTime = substepBody.lastDeltaTime;
+	substepBody.elapsedTime += DeltaTime;
+	substepBody.lastDeltaTime = DeltaTime;
+	if (substepBody.crossedTime >= 0.0f) return;
+
+	// Check the motion since the last substep. NOTE: The scene is locked by the substep so the body can be read and moved directly.
+	// NOTE: Callbacks run before their substep integrates so the motion found here happened during the previous substep.
+	FTransform bodyTransform = bodyInstance->GetUnrealWorldTransform_AssumesLocked();
+	FVector currLocation = bodyTransform.GetLocation();
+	float timeOfImpact;
+	if (FPortalMath::SweepThroughAperture(substepAperture, substepApertureExtent, substepBody.lastOrigin, currLocation, substepBody.boxExtent, timeOfImpact))
+	{
+		// Teleport the body with its velocities so the rest of the step simulates at the target portal.
+		FVector newLinearVelocity = substepToTarget.TransformVectorNoScale(bodyInstance->GetUnrealWorldVelocity_AssumesLocked());
+		FVector newAngularVelocity = substepToTarget.TransformVectorNoScale(bodyInstance->GetUnrealWorldAngularVelocityInRadians_AssumesLocked());
+		bodyTransform.SetLocation(substepToTarget.TransformPositionNoScale(currLocation));
+		bodyTransform.SetRotation(substepToTarget.GetRotation() * bodyTransform.GetRotation());
+		bodyInstance->SetBodyTransform(bodyTransform, ETeleportType::TeleportPhysics);
+		bodyInstance->SetLinearVelocity(newLinearVelocity, false);
+		bodyInstance->SetAngularVelocityInRadians(newAngularVelocity, false);
+		substepBody.crossedTime = lastStartTime + timeOfImpact * lastDeltaTime;
+	}
+	substepBody.lastOrigin = currLocation;
+}
+
+void APortal::DeleteCopy(AActor* actorToDelete)
+{
+	// Give the visual copy of the tracked actor back to the portal managers pool.
+	// NOTE: Pooled so actors leaving the portal don't destroy their copy and force a garbage collection.
+	FTrackedActorHandle trackedActor = trackedActors.Find(actorToDelete);
+	int32 index = trackedActors.GetIndex(trackedActor);
+	if (index != INDEX_NONE && trackedActors.instancers[index] != INDEX_NONE)
+	{
+		// Instances are freed in the target portal that owns them.
+		if (pTargetPortal) pTargetPortal->RemoveDuplicateInstance(trackedActors.instancers[index], trackedActors.instances[index]);
+		trackedActors.SetInstance(trackedActor, INDEX_NONE, INDEX_NONE);
+	}
+	else if (AActor* isValid = trackedActors.FindDuplicate(actorToDelete))
+	{
+		// Also remove from the duplicate lookup.
+		trackedActors.SetDuplicate(trackedActor, nullptr);
+		if (portalManager) portalManager->ReleaseDuplicate(isValid);
 	}
 }
 
 void APortal::CopyActor(AActor* actorToCopy)
 {
-	// NOTE: CODE IS ONLY TESTED FOR STATIC MESHES AND THE PLAYER... CHECKS ROOT COMPONENT ONLY.
-	// Create copy of the given actor.
-	FName newActorName = MakeUniqueObjectName(this, AActor::StaticClass(), "CoppiedActor");
-	AActor* newActor = NewObject<AActor>(this, newActorName, RF_NoFlags, actorToCopy);
-	TArray<UActorComponent*> foundStaticMeshes = newActor->GetComponentsByClass(UStaticMeshComponent::StaticClass());
-	newActor->RegisterAllComponents();
+	// Location and rotation for this frame at the target portal.
+	FPortalTransform& portalTransform = GetTargetTransform();
+	FVector newLoc = portalTransform.TransformLocation(actorToCopy->GetActorLocation());
+	FQuat newRot = portalTransform.TransformRotation(actorToCopy->GetActorQuat());
+
+	// Show the copy as an instance in the target portals instanced meshes if it can be.
+	FTrackedActorHandle trackedActor = trackedActors.Find(actorToCopy);
+	if (instancedDuplicates && pTargetPortal && CanInstanceDuplicate(actorToCopy))
+	{
+		int32 instancer;
+		FTransform newTransform = FTransform(newRot, newLoc, actorToCopy->GetActorScale3D());
+		int32 instance = pTargetPortal->AddDuplicateInstance(actorToCopy, newTransform, instancer);
+		trackedActors.SetInstance(trackedActor, instancer, instance);
+
+		// Hide until it is overlapping the portal mesh.
+		HideDuplicate(actorToCopy);
+		return;
+	}
+
+	// Borrow a copy of the given actor from the portal managers pool.
+	if (!portalManager) return;
+	AActor* newActor = portalManager->AcquireDuplicate(actorToCopy);
+	if (!newActor) return;
+
+	// Update the actors tracking information. NOTE: Also maps the duplicate back to the original actor.
+	trackedActors.SetDuplicate(trackedActor, newActor);
+
+	// Setup location and rotation for this frame. NOTE: From the original as a pooled copy is wherever it was last used.
+	newActor->SetActorLocationAndRotation(newLoc, newRot);
+
+	// Hide from main pass until it is overlapping the portal mesh.
+	HideActor(newActor);
+}
+
+bool APortal::CanInstanceDuplicate(AActor* actor) const
+{
+	if (actor->IsA<APortalPawn>()) return false;
+	UStaticMeshComponent* rootMesh = Cast<UStaticMeshComponent>(actor->GetRootComponent());
+	if (!rootMesh || !rootMesh->GetStaticMesh()) return false;
+	TInlineComponentArray<UStaticMeshComponent*> meshes;
+	actor->GetComponents(meshes);
+	return meshes.Num() == 1;
+}
 
-	// If its the player disable any important functionality.
-	if (APortalPawn* isPawn = Cast<APortalPawn>(newActor))
+int32 APortal::AddDuplicateInstance(AActor* source, const FTransform& transform, int32& outInstancer)
+{
+	// Find the instancer with the same mesh and materials.
+	UStaticMeshComponent* sourceMesh = Cast<UStaticMeshComponent>(source->GetRootComponent());
+	TArray<UMaterialInterface*> sourceMaterials = sourceMesh->GetMaterials();
+	outInstancer = INDEX_NONE;
+	for (int i = 0; i < duplicateInstancers.Num(); i++)
 	{
-		isPawn->playerCapsule->SetCollisionResponseToChannel(ECC_PortalBox, ECR_Ignore);
-		isPawn->playerCapsule->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);
-		isPawn->playerCapsule->SetSimulatePhysics(false);
-		isPawn->PrimaryActorTick.SetTickFunctionEnable(false);
+		UInstancedStaticMeshComponent* instancedMesh = duplicateInstancers[i].component;
+		if (instancedMesh && instancedMesh->GetStaticMesh() == sourceMesh->GetStaticMesh() && instancedMesh->GetMaterials() == sourceMaterials)
+		{
+			outInstancer = i;
+			break;
+		}
 	}
-	// Else assume its a static mesh or handle other objects HERE...
-	else
+
+	// Otherwise make a new one.
+	if (outInstancer == INDEX_NONE)
 	{
-		// Make sure static meshes ignore portal to avoid duplicates of duplicates being made...
-		// NOTE: Causes an issue where the duplicate when ran into will not be moved by the player
-		// FIXED: Fix for this was to duplicate the player as-well and drive its position...
-		for (UActorComponent* comp : foundStaticMeshes)
+		UInstancedStaticMeshComponent* instancedMesh = NewObject<UInstancedStaticMeshComponent>(this);
+		instancedMesh->SetMobility(EComponentMobility::Movable);
+		instancedMesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		instancedMesh->SetStaticMesh(sourceMesh->GetStaticMesh());
+		for (int i = 0; i < sourceMaterials.Num(); i++)
 		{
-			UStaticMeshComponent* staticComp = (UStaticMeshComponent*)comp;
-			staticComp->SetCollisionResponseToChannel(ECC_PortalBox, ECR_Ignore);
-			staticComp->SetCollisionResponseToChannel(ECC_Interactable, ECR_Ignore);
-			staticComp->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);// Ignore pawn.
-			staticComp->SetSimulatePhysics(false);
+			instancedMesh->SetMaterial(i, sourceMaterials[i]);
 		}
+		instancedMesh->SetCastShadow(sourceMesh->CastShadow);
+		instancedMesh->SetupAttachment(GetRootComponent());
+		instancedMesh->RegisterComponent();
+		outInstancer = duplicateInstancers.AddDefaulted();
+		duplicateInstancers[outInstancer].component = instancedMesh;
+
+		// The instances move so this portal needs re-checking for show only lists.
+		if (portalManager) portalManager->RegisterDynamicActor(this);
 	}
-	
-	// Update the actors tracking information.
-	FTrackedActor newTrackingInfo = trackedActors.FindRef(actorToCopy);
-	newTrackingInfo.trackedDuplicate = newActor;
-	trackedActors.Remove(actorToCopy);
-	trackedActors.Add(actorToCopy, newTrackingInfo);
-
-	// Setup location and rotation for this frame.
-	FVector newLoc = ConvertLocationToPortal(newActor->GetActorLocation(), this, pTargetPortal);
-	FRotator newRot = ConvertRotationToPortal(newActor->GetActorRotation(), this, pTargetPortal);
-	newActor->SetActorLocationAndRotation(newLoc, newRot);
+	return duplicateInstancers[outInstancer].AddInstance(transform);
+}
 
-	// Create duplicate map to original actor.
-	duplicateMap.Add(newActor, actorToCopy);
+void APortal::RemoveDuplicateInstance(int32 instancer, int32 instance)
+{
+	if (duplicateInstancers.IsValidIndex(instancer)) duplicateInstancers[instancer].RemoveInstance(instance);
+}
 
-	// Hide from main pass until it is overlapping the portal mesh.
-	HideActor(newActor);
+void APortal::GetPortalCorners(FVector outCorners[4])
+{
+	// Corners of the portal plane relative to the portal mesh.
+	// NOTE: Ensure portal box is setup correctly for this to work.
+	FTransform portalTransform = portalMesh->GetComponentTransform();
+	FVector portalSize = portalBox->GetScaledBoxExtent();
+	outCorners[0] = portalTransform.TransformPositionNoScale(FVector(0.0f, -portalSize.Y, -portalSize.Z));
+	outCorners[1] = portalTransform.TransformPositionNoScale(FVector(0.0f, portalSize.Y, -portalSize.Z));
+	outCorners[2] = portalTransform.TransformPositionNoScale(FVector(0.0f, portalSize.Y, portalSize.Z));
+	outCorners[3] = portalTransform.TransformPositionNoScale(FVector(0.0f, -portalSize.Y, portalSize.Z));
+}
+
+float APortal::GetDistanceToPortal(FVector location)
+{
+	// Clamp the location to the portals plane within its extent.
+	FVector relativeLocation = portalMesh->GetComponentTransform().InverseTransformPositionNoScale(location);
+	FVector portalSize = portalBox->GetScaledBoxExtent();
+	FVector closestPoint = FVector(0.0f, FMath::Clamp(relativeLocation.Y, -portalSize.Y, portalSize.Y), FMath::Clamp(relativeLocation.Z, -portalSize.Z, portalSize.Z));
+	return FVector::Dist(relativeLocation, closestPoint);
 }
 
 bool APortal::IsInfront(FVector location)
@@ -621,20 +1710,24 @@ bool APortal::IsInfront(FVector location)
 FVector APortal::ConvertDirectionToTarget(FVector direction)
 {
 	// Flip the given direction to the target portal.
-	FVector flippedVel;
-	flippedVel.X = FVector::DotProduct(direction, portalMesh->GetForwardVector());
-	flippedVel.Y = FVector::DotProduct(direction, portalMesh->GetRightVector());
-	flippedVel.Z = FVector::DotProduct(direction, portalMesh->GetUpVector());
-	FVector newVelocity = flippedVel.X * -pTargetPortal->portalMesh->GetForwardVector()
-					    + flippedVel.Y * -pTargetPortal->portalMesh->GetRightVector()
-						+ flippedVel.Z * pTargetPortal->portalMesh->GetUpVector();
-	
-	// Return flipped vector for the given direction.
-	return newVelocity;
+	return GetTargetTransform().TransformDirection(direction);
+}
+
+FPortalTransform& APortal::GetTargetTransform()
+{
+	// Only rebuilds the cached transform if either portal has moved.
+	if (pTargetPortal) targetTransform.Update(portalMesh->GetComponentTransform(), pTargetPortal->portalMesh->GetComponentTransform());
+	return targetTransform;
 }
 
 FVector APortal::ConvertLocationToPortal(FVector location, APortal* currentPortal, APortal* endPortal, bool flip)
 {
+	// Use the cached transform when converting to this portals target.
+	if (currentPortal == this && endPortal == pTargetPortal && endPortal && flip)
+	{
+		return GetTargetTransform().TransformLocation(location);
+	}
+
 	// Convert location to new portal.
 	FVector posRelativeToPortal = currentPortal->portalMesh->GetComponentTransform().InverseTransformPositionNoScale(location);
 	if (flip)
@@ -650,6 +1743,12 @@ FVector APortal::ConvertLocationToPortal(FVector location, APortal* currentPorta
 
 FRotator APortal::ConvertRotationToPortal(FRotator rotation, APortal* currentPortal, APortal* endPortal, bool flip)
 {
+	// Use the cached transform when converting to this portals target.
+	if (currentPortal == this && endPortal == pTargetPortal && endPortal && flip)
+	{
+		return GetTargetTransform().TransformRotation(rotation.Quaternion()).Rotator();
+	}
+
 	// Convert rotation to new portal.
 	FRotator relativeRotation = currentPortal->portalMesh->GetComponentTransform().InverseTransformRotation(rotation.Quaternion()).Rotator();
 	if (flip)
@@ -679,16 +1778,22 @@ bool APortal::LocationInsidePortal(FVector location)
 
 int APortal::GetNumberOfTrackedActors()
 {
-	return actorsBeingTracked;
+	return trackedActors.Num();
 }
 
-TMap<AActor*, AActor*>& APortal::GetDuplicateMap()
+TMap<AActor*, AActor*> APortal::GetDuplicateMap()
 {
+	TMap<AActor*, AActor*> duplicateMap;
+	for (int i = 0; i < trackedActors.Num(); i++)
+	{
+		if (AActor* duplicate = trackedActors.duplicates[i]) duplicateMap.Add(duplicate, trackedActors.actors[i]);
+	}
 	return duplicateMap;
 }
 
-void FPostPhysicsTick::ExecuteTick(float DeltaTime, enum ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+AActor* APortal::GetDuplicateSource(AActor* duplicate)
 {
-	// Call the Portals second tick function for running post tick.
-	if (Target) Target->PostPhysicsTick(DeltaTime);
+	int32 index = trackedActors.GetIndex(trackedActors.FindByDuplicate(duplicate));
+	return index != INDEX_NONE ? trackedActors.actors[index] : nullptr;
 }
+
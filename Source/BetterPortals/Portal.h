@@ -3,63 +3,173 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "HelperMacros.h"
+#include "StereoRendering.h"
+#include "PortalMath.h"
+#include "PortalTracking.h"
 #include "Portal.generated.h"
 
 /* Logging category for this class. */
 DECLARE_LOG_CATEGORY_EXTERN(LogPortal, Log, All);
 
-/* Structure to hold important tracking information with each overlapping actor. */
+/* How often a portal updates its view. */
+UENUM(BlueprintType)
+enum class EPortalUpdateRate : uint8
+{
+	EVERYFRAME UMETA(DisplayName = "Every Frame"),
+	FRAMES UMETA(DisplayName = "Every N Frames"),
+	TIME UMETA(DisplayName = "Every N Milliseconds"),
+	AUTOMATIC UMETA(DisplayName = "Automatic")
+};
+
+/* Render settings used by the portal capture for one level of recursion. Deeper recursions are smaller on screen so can use cheaper settings. */
 USTRUCT(BlueprintType)
-struct FTrackedActor
+struct FPortalCaptureProfile
 {
 	GENERATED_BODY()
 
 public:
 
-	FVector lastTrackedOrigin;
-	USceneComponent* trackedComp;
-	AActor* trackedDuplicate;
+	/* Render dynamic shadows. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool shadows;
+
+	/* Render point, spot and rect lights. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool dynamicLights;
+
+	/* Render translucent primitives. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool translucency;
+
+	/* Apply the players cameras post process settings. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool postProcess;
+
+	/* Scales the distance used for picking LODs, higher values use lower detail LODs sooner. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal", meta = (ClampMin = "0.0"))
+	float lodDistanceFactor;
+
+	/* Primitives further than this from the capture aren't rendered. NOTE: Zero means no limit. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal", meta = (ClampMin = "0.0"))
+	float maxViewDistance;
 
 public:
 
 	/* Default Constructor. */
-	FTrackedActor()
+	FPortalCaptureProfile()
 	{
-		lastTrackedOrigin = FVector::ZeroVector;
-		trackedComp = nullptr;
-		trackedDuplicate = nullptr;
+		shadows = true;
+		dynamicLights = true;
+		translucency = true;
+		postProcess = true;
+		lodDistanceFactor = 3.0f;
+		maxViewDistance = 0.0f;
 	}
 
 	/* Main Constructor. */
-	FTrackedActor(USceneComponent* trackingComponent)
+	FPortalCaptureProfile(bool renderShadows, bool renderDynamicLights, bool renderTranslucency, bool renderPostProcess, float lodFactor, float maxDistance)
 	{
-		lastTrackedOrigin = trackingComponent->GetComponentLocation();
-		trackedComp = trackingComponent;
-		trackedDuplicate = nullptr;
+		shadows = renderShadows;
+		dynamicLights = renderDynamicLights;
+		translucency = renderTranslucency;
+		postProcess = renderPostProcess;
+		lodDistanceFactor = lodFactor;
+		maxViewDistance = maxDistance;
 	}
 };
 
-/* Post physics update tick for updating position as my pawn position is physics driven. 
- * NOTE: This is irrelevant for a pawn that is not physics driven.
- * NOTE: This is always relevant way of tracking actors that are moving via physics.
- * NOTE: Important for checking the tracking state of the HMD and hands. 
- */
+/* A local players view of a portal. Each viewer sees the portal through its own mesh and material showing its own captures.
+ * NOTE: The first viewer uses the portals own mesh which is the only one seen by portal captures. */
 USTRUCT()
-struct FPostPhysicsTick : public FActorTickFunction
+struct FPortalView
 {
 	GENERATED_BODY()
 
-	/* Target actor. */
-	class APortal* Target;
+public:
 
-	/* Declaration of the new ticking function for this class. */
-	virtual void ExecuteTick(float DeltaTime, enum ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
-};
+	/* The mesh this viewer sees the portal through. */
+	UPROPERTY()
+	class UStaticMeshComponent* mesh;
 
-template <>
-struct TStructOpsTypeTraits<FPostPhysicsTick> : public TStructOpsTypeTraitsBase2<FPostPhysicsTick>
-{
-	enum { WithCopy = false };
+	/* The dynamic material instance on the mesh. */
+	UPROPERTY()
+	class UMaterialInstanceDynamic* material;
+
+	/* The render target for the full view or the left eye when rendering in stereo. NOTE: Borrowed from the portal manager while on screen. */
+	UPROPERTY()
+	class UCanvasRenderTarget2D* renderTarget;
+
+	/* The render target for the right eye when rendering in stereo. */
+	UPROPERTY()
+	class UCanvasRenderTarget2D* renderTargetRight;
+
+	/* The render target the last capture is warped into on frames it isn't updated. NOTE: Borrowed from the portal manager while in use. */
+	UPROPERTY()
+	class UCanvasRenderTarget2D* reprojectedTarget;
+
+	/* The render target the last right eye capture is warped into on frames it isn't updated. */
+	UPROPERTY()
+	class UCanvasRenderTarget2D* reprojectedTargetRight;
+
+	/* The player controller this view was created for. */
+	UPROPERTY()
+	class APlayerController* controller;
+
+	FLinearColor scaleBias[2]; /* Screen UV scale and bias from the viewers screen to the last cropped capture for each eye. */
+	bool stereo; /* Was the view last captured for each eye. */
+	float resolution; /* The current percentage of the screen resolution being rendered. */
+	float screenCoverage; /* Fraction of the screen the portal covered when last captured. */
+	bool cached; /* Is the last capture still valid to compare against for skipping updates. */
+	FVector lastCaptureLoc; /* Location of the portal capture when last updated. */
+	FQuat lastCaptureRot; /* Rotation of the portal capture when last updated. */
+	FMatrix lastCaptureProjection; /* The viewers projection matrix when last updated. */
+	FIntPoint lastViewportSize; /* The viewers viewport size when last updated. */
+	uint32 lastDestinationHash; /* Hash of the movable primitives in front of the target portal when last updated. */
+	float lastCaptureTime; /* World time the view was last captured. */
+	FVector lastPawnLoc; /* The viewers pawns last tracked location for calculating when to teleport it. */
+	FVector captureViewLoc[2]; /* Location of the portal capture for each eye when last captured. */
+	FQuat captureViewRot[2]; /* Rotation of the portal capture for each eye when last captured. */
+	FLinearColor captureUnproject[2]; /* Unproject parameters of the cropped projection for each eye when last captured. */
+	FLinearColor captureDepth[2]; /* Depth parameters of the projection each eye was last captured with, see FPortalMath::GetDepthParameters. */
+	FBox2D captureBounds[2]; /* Screen bounds each eyes last capture was cropped to, the full screen when not cropped. */
+	bool reprojected[2]; /* Is each eye showing its warped render target instead of its capture. */
+	uint64 captureFrame; /* Frame counter when the view was last captured. */
+
+public:
+
+	/* Default Constructor. */
+	FPortalView()
+	{
+		mesh = nullptr;
+		material = nullptr;
+		renderTarget = nullptr;
+		renderTargetRight = nullptr;
+		reprojectedTarget = nullptr;
+		reprojectedTargetRight = nullptr;
+		controller = nullptr;
+		stereo = false;
+		for (int eye = 0; eye < 2; eye++) scaleBias[eye] = FLinearColor(1.0f, 1.0f, 0.0f, 0.0f);
+		resolution = 1.0f;
+		screenCoverage = 1.0f;
+		cached = false;
+		lastCaptureLoc = FVector::ZeroVector;
+		lastCaptureRot = FQuat::Identity;
+		lastCaptureProjection = FMatrix::Identity;
+		lastViewportSize = FIntPoint::ZeroValue;
+		lastDestinationHash = 0;
+		lastCaptureTime = 0.0f;
+		lastPawnLoc = FVector::ZeroVector;
+		for (int eye = 0; eye < 2; eye++)
+		{
+			captureViewLoc[eye] = FVector::ZeroVector;
+			captureViewRot[eye] = FQuat::Identity;
+			captureUnproject[eye] = FLinearColor(1.0f, 1.0f, 0.0f, 0.0f);
+			captureDepth[eye] = FLinearColor(0.0f, 0.0f, 0.0f, 0.0f);
+			captureBounds[eye] = FBox2D(FVector2D(0.0f, 0.0f), FVector2D(1.0f, 1.0f));
+			reprojected[eye] = false;
+		}
+		captureFrame = 0;
+	}
 };
 
 /* Portal class to handle visualizing a portal to its target portal as well as teleportation of the players
@@ -68,9 +178,6 @@ UCLASS()
 class BETTERPORTALS_API APortal : public AActor
 {
 	GENERATED_BODY()
-	
-	/* Make post physics friend so it can access the tick function. */
-	friend FPostPhysicsTick;
 
 public:	
 	
@@ -78,9 +185,9 @@ public:
 	UPROPERTY(BlueprintReadWrite, VisibleAnywhere, Category = "Portal")
 	class UStaticMeshComponent* portalMesh;
 
-	/* Box overlap component for teleporting actors. 
-	 * NOTE: Used instead of overlaps with the portalMesh because the physics doesn't call overlaps if the mesh passed through something that doesn't block.
-	 *       This also still happens with CCD enabled as its mainly for blocking physics between frames not calling overlaps... */
+	/* Box around the portal for finding actors that might teleport.
+	 * NOTE: Has no collision, the portal managers broadphase tests physics bodies against it every frame with their bounds swept back along their
+	 *       velocity so fast bodies aren't missed the way CCD overlap events missed them. */
 	UPROPERTY(BlueprintReadWrite, VisibleAnywhere, Category = "Portal")
 	class UBoxComponent* portalBox;
 
@@ -96,126 +203,369 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
 	class UMaterialInterface* portalMaterialInstance;
 
-	/* The max number of times a portal can recurse any portals. NOTE: Only target portal is supported for now. */
+	/* The max number of times a portal can recurse through itself.
+	 * NOTE: Other portals seen through this portal are found by the portal managers visibility traversal.
+	 * NOTE: Recursion stops early once the recursive portal is off screen, behind the camera, hidden or smaller than recursionPixelThreshold. */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
 	int recursionAmount;
 
-	/* The percentage of the screen resolution to render the portal at. */
+	/* The minimum area in screen pixels a recursive portal must cover to be rendered. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal", meta = (ClampMin = "0.0"))
+	float recursionPixelThreshold;
+
+	/* The percentage of the screen resolution to render the portal at when close up and covering the screen. */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal", meta = (UIMin = "0.0", UIMax = "1.0", ClampMin = "0.0", ClampMax = "1.0"))
 	float resolutionPercentile;
 
+	/* The lowest percentage of the screen resolution to render the portal at when far away or small on screen. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Resolution", meta = (UIMin = "0.0", UIMax = "1.0", ClampMin = "0.0", ClampMax = "1.0"))
+	float minResolutionPercentile;
+
+	/* Distance from the portal the resolution starts to drop from resolutionPercentile. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Resolution", meta = (ClampMin = "0.0"))
+	float fullResolutionDistance;
+
+	/* Distance from the portal the resolution reaches minResolutionPercentile. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Resolution", meta = (ClampMin = "0.0"))
+	float minResolutionDistance;
+
+	/* Fraction of the screen the portal must cover to render at full resolution, smaller portals drop in resolution. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Resolution", meta = (UIMin = "0.0", UIMax = "1.0", ClampMin = "0.0", ClampMax = "1.0"))
+	float fullResolutionCoverage;
+
+	/* How much the wanted resolution must change by as a fraction of the current resolution before it is applied. Stops it thrashing. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Resolution", meta = (UIMin = "0.0", UIMax = "1.0", ClampMin = "0.0"))
+	float resolutionHysteresis;
+
+	/* Clip the portal view using an oblique near plane built into the projection matrix instead of the scene captures clip plane.
+	 * NOTE: When disabled r.AllowGlobalClipPlane needs enabling in DefaultEngine.ini, this costs extra for every view in the project. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool obliqueClipping;
+
+	/* Crop the portal captures frustum and render target to the portals bounds on screen so nothing outside of the portal is rendered.
+	 * NOTE: Disabled at setup if the portal material doesn't have the PortalUVScaleBias vector parameter to remap its screen UVs (UV * XY + ZW),
+	 *       without it the portal would show a squashed and offset image. The shipped M_Portal and M_PortalVR materials don't have it yet
+	 *       so this does nothing until they multiply their screen UVs by it. Stereo views are never cropped. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool cropCaptureToPortal;
+
+	/* How often to update the portals view. Automatic picks between every frame, every 2 frames and every 4 frames from the
+	 * portals distance and coverage on screen. NOTE: Updates are offset between portals so they don't all update on the same frame. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate")
+	EPortalUpdateRate updateRate;
+
+	/* Number of frames between updates when using the Every N Frames update rate. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate", meta = (ClampMin = "1"))
+	int updateFrameInterval;
+
+	/* Milliseconds between updates when using the Every N Milliseconds update rate. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate", meta = (ClampMin = "0.0"))
+	float updateTimeInterval;
+
+	/* Automatic update rate updates every frame within this distance or while covering fullRateCoverage of the screen. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate", meta = (ClampMin = "0.0"))
+	float fullRateDistance;
+
+	/* Automatic update rate updates every 2 frames within this distance, every 4 frames outside of it. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate", meta = (ClampMin = "0.0"))
+	float halfRateDistance;
+
+	/* Automatic update rate updates every frame while the portal covers this fraction of the screen. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate", meta = (UIMin = "0.0", UIMax = "1.0", ClampMin = "0.0", ClampMax = "1.0"))
+	float fullRateCoverage;
+
+	/* Warp the last capture to the current view on frames the portal isn't updated using the scene depth stored in its alpha.
+	 * NOTE: Hides the lower update rate while the camera moves, areas that weren't in the last capture stretch from its edges. Needs SM5. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Update Rate")
+	bool reprojectStaleCaptures;
+
+	/* Capture each eye into its own render target when rendering in stereo, sampled by M_PortalVR through RT_LeftEye and RT_RightEye.
+	 * NOTE: Stereo captures aren't cropped to the portal as M_PortalVR has no scale and bias parameters. Can be tested without a HMD
+	 *       using -emulatestereo. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool stereoCaptures;
+
+	/* Only render primitives that could be seen through the target portal, those in front of it within destinationViewDistance.
+	 * NOTE: Non-movable primitives are found once, movable and spawned actors are re-checked every update through the portal manager.
+	 *       Off by default as components added at runtime to an actor placed in the level aren't found until the next level streams in,
+	 *       register those actors with APortalManager::RegisterDynamicActor before enabling it. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Show Only")
+	bool useShowOnlyList;
+
+	/* The furthest distance from the target portal a primitive can be seen through the portal. NOTE: Zero means no limit. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Show Only", meta = (ClampMin = "0.0"))
+	float destinationViewDistance;
+
+	/* Skip updating the portals view when the camera hasn't moved relative to the portal and nothing movable in front of the target
+	 * portal has moved or is animating since the last capture, keeping the last texture instead.
+	 * NOTE: Moving primitives are found from the portal managers dynamic actors, anything else is caught by captureCacheMaxAge. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Capture Cache")
+	bool cacheCaptures;
+
+	/* How far in front of the target portal to look for moving primitives that would change the portals view. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Capture Cache", meta = (ClampMin = "0.0"))
+	float captureCacheDistance;
+
+	/* The longest time in seconds a cached view is kept before being updated anyway. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Capture Cache", meta = (ClampMin = "0.0"))
+	float captureCacheMaxAge;
+
+	/* Capture settings for each level of recursion starting with the view through this portal.
+	 * NOTE: Recursions past the end of the array use the last profile with its LOD distance factor increased for each extra level. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Capture Profiles")
+	TArray<FPortalCaptureProfile> captureProfiles;
+
+	/* Show the duplicates of static mesh actors tracked by this portal as instances owned by the target portal instead of actor copies.
+	 * Every tracked actor with the same mesh and materials is drawn in one draw call. NOTE: Instances have no collision and don't cast
+	 * shadows while hidden, actors with more than one static mesh or that aren't rooted by one still use actor copies. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool instancedDuplicates;
+
+	/* Test physics simulating tracked actors for crossing the portal in every physics substep and teleport them there with their velocities,
+	 * so a body that passes through and bounces back within a frame is still teleported. The rest of the teleport such as the tracking and
+	 * camera cut still happens after physics.
+	 * NOTE: Does nothing unless substepping is enabled in the projects physics settings (bSubstepping, off by default in this project).
+	 *       The callbacks run before each substep integrates so without substeps the body hasn't moved yet and no crossing can be found,
+	 *       a warning is logged at setup and crossings are only found after physics as usual. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	bool substepCrossings;
+
 	/* Debug the duplicated camera position and rotation relative to the other portal by drawing debug cube based of scenecapture2D transform. */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Debugging")
 	bool debugCameraTransform;
 
-	/* Log when a new actor is added to the trackedActors map and when one is removed. */
+	/* Log when a new actor is added to the tracked actors and when one is removed. */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Debugging")
 	bool debugTrackedActors;
 
-	/* Post ticking declaration. */
-	FPostPhysicsTick physicsTick;
-
 	/* Portal class target portal. */
 	APortal* pTargetPortal;
 
-	/* Is this portal active? NOTE: Currently does nothing but is true when its being updated. */
+	/* Is this portal active? NOTE: Only active portals are updated, captured, track actors and teleport them by the portal manager. */
 	bool active; 
 
 protected:
 
-	/* The player controller. */
+	/* The portal manager this portal borrows its render targets and viewers from. */
 	UPROPERTY()
-	class APlayerController* portalController; 
+	class APortalManager* portalManager;
 
-	/* The portal pawn. */
+	/* The portals dynamic material instance, used by the first viewer and seen by portal captures. */
 	UPROPERTY()
-	class APortalPawn* portalPawn; 
+	class UMaterialInstanceDynamic* portalMaterial; 
 
-	/* The portals render target texture. */
+	/* Each local players view of the portal, indexed the same as the portal managers viewers. */
 	UPROPERTY()
-	class UCanvasRenderTarget2D* renderTarget; 
+	TArray<FPortalView> views;
 
-	/* The performance render targets used when latePortalUpdate is being used. */
+	/* The tracked actors with their tracked component, last location and duplicate at the target portal.
+	 * NOTE: Also finds an original actor from a tracked duplicate actor from a hit result for example on a duplicate. */
 	UPROPERTY()
-	TArray<UCanvasRenderTarget2D*> renderTargets; 
+	FTrackedActorSet trackedActors;
 
-	/* The portals dynamic material instance. */
+	/* Instanced meshes showing the duplicates of actors tracked by portals targeting this one, one per mesh and material combination. */
 	UPROPERTY()
-	class UMaterialInstanceDynamic* portalMaterial; 
+	TArray<FDuplicateInstancer> duplicateInstancers;
 
-	/* Tracked actor map where each tracked actor has tracked settings like last location etc. */
+	/* The actors the portal managers broadphase found overlapping the portal box and mesh last frame. */
 	UPROPERTY()
-	TMap<AActor*, FTrackedActor> trackedActors; 
-
-	/* Map to find an original actor from a tracked duplicate actor from a hit result for example on a duplicate. */
+	TArray<AActor*> boxOverlaps;
 	UPROPERTY()
-	TMap<AActor*, AActor*> duplicateMap; 
+	TArray<AActor*> meshOverlaps;
 
 private:
 
-	bool initialised; /* Has begin play been ran. */
-	int actorsBeingTracked; /* Number of actors currently being tracked. */
-	int currentFrameCount; /* Frame count for updating the portals one frame late. */
-	FVector lastPawnLoc; /* The pawns last tracked location for calculating when to teleport the player. */
+	bool initialised; /* Has setup been ran. */
+	int currentFrameCount; /* Number of updates since the portal was last activated. */
+	int updatePhase; /* Offset for when this portal updates so portals on the same update rate don't update on the same frame. */
+	float lastUpdateTime; /* World time the portals view was last updated. */
+	float lastScreenCoverage; /* Largest fraction of any viewers screen the portal covered when last updated. */
+	FPortalTransform targetTransform; /* Cached transform to the target portal, use GetTargetTransform to access. */
+	uint64 destinationHashFrame; /* Frame the destination hash was last found on, shared by every viewer that frame. */
+	uint32 frameDestinationHash; /* Destination hash found on destinationHashFrame. */
+	bool frameDestinationAnimated; /* Was anything animating in front of the target portal on destinationHashFrame. */
+	int skippedCaptures; /* Number of viewer captures skipped as the viewers last capture was still valid, counted per view. */
+	bool captureRequested; /* Is a capture waiting to be issued by the portal manager. */
+	int lastCaptureCount; /* Number of captures including recursions the portals view last needed. */
+	float averageCaptureCost; /* Average render thread milliseconds taken to update the portals view. */
+	int numStaticShowOnly; /* Number of non-movable primitives at the start of the capture show only list. */
+	int showOnlySceneVersion; /* The portal managers scene version when the non-movable show only primitives were found. */
+	FTransform showOnlyTargetTransform; /* The target portals transform when the non-movable show only primitives were found. */
+	TArray<FSubstepBody> substepBodies; /* Tracked bodies tested in this frames physics substeps. */
+	FTransform substepAperture; /* The portal meshes transform when the substep bodies were queued. */
+	FVector2D substepApertureExtent; /* The portals aperture extent when the substep bodies were queued. */
+	FTransform substepToTarget; /* Transform to the target portal when the substep bodies were queued. */
+
+	/* Called when an actor enters the portal box. Tracks it if its a physics actor that was in front of the portal last frame. */
+	void OnPortalBoxEnter(AActor* enteringActor, const FVector& lastOrigin);
+
+	/* Called when an actor leaves the portal box. */
+	void OnPortalBoxExit(AActor* exitingActor);
+
+	/* Called when an actor starts touching the portal mesh. */
+	void OnPortalMeshEnter(AActor* enteringActor);
+
+	/* Called when an actor stops touching the portal mesh. */
+	void OnPortalMeshExit(AActor* exitingActor);
+
+	/* Stop tracking an actor when its destroyed as the broadphase only finds actors that still exist. */
+	UFUNCTION()
+	void OnTrackedActorDestroyed(AActor* destroyedActor);
+
+	/* Function to teleport a given actor. NOTE: Only updates the actors tracking and the views if its body was already teleported in a substep. */
+	void TeleportObject(AActor* actor, bool teleportedInSubstep = false);
 
-	/* Function to teleport a given actor. */
-	void TeleportObject(AActor* actor);
+	/* Physics substep callback testing a queued body for crossing the portal and teleporting it if it has.
+	 * NOTE: Can run on the physics thread so only touches its substep body and the body instance. */
+	void SubstepTrackedBody(float DeltaTime, struct FBodyInstance* bodyInstance, int32 substepIndex);
 
-	/* Deletes a copied version of another actor. */
+	/* Returns a copied version of another actor to the portal managers pool. */
 	void DeleteCopy(AActor* actorToDelete);
 
 	/* copies a given actors static mesh root component and sets it in the tracked actor struct.
-	 * NOTE: Only static meshes are duplicated but this is easily added. */
+	 * NOTE: Only static meshes are duplicated but this is easily added. Copies are borrowed from the portal managers pool. */
 	void CopyActor(AActor* actorToCopy);
 
-	/* Create a render texture target for this portal. */
+	/* Can an actors duplicate be shown as an instance. Only if its a single static mesh that isn't a pawn. */
+	bool CanInstanceDuplicate(AActor* actor) const;
+
+	/* Add an instance of an actors mesh to this portals duplicate instancers. Returns the instance and the instancer it was added to. */
+	int32 AddDuplicateInstance(AActor* source, const FTransform& transform, int32& outInstancer);
+
+	/* Hide and free an instance in this portals duplicate instancers. */
+	void RemoveDuplicateInstance(int32 instancer, int32 instance);
+
+	/* Create the dynamic material for this portal. */
 	void CreatePortalTexture();
 
-	/* Updates the pawns tracking for going through portals. Cannot rely on detecting overlaps. */
-	void UpdatePawnTracking();
+	/* Match the portals views to the portal managers viewers, creating a mesh and material for each viewer after the first. */
+	void UpdateViews();
 
-	/* Update the tracked actors relative to the target portal. 
-	 * NOTE: Takes care of teleporting physics objects as well as duplicating them and the pawn if overlapping... */
-	void UpdateTrackedActors();
+	/* Borrow a render target of the given size for a viewers eye from the portal manager if the current one isn't in the same size bucket.
+	 * Returns false if no render target could be found. NOTE: Eye 0 is the left eye or the full view, eye 1 is the right eye. */
+	bool UpdatePortalTexture(int viewer, FIntPoint size, int eye = 0);
+
+	/* Returns the current render target for a viewers eye. */
+	class UCanvasRenderTarget2D* GetPortalTexture(int viewer, int eye) const;
+
+	/* Does the viewer have a render target for every eye it was last captured for. */
+	bool HasPortalTextures(int viewer) const;
+
+	/* Does every viewer have a render target for every eye it was last captured for. */
+	bool HasPortalTextures() const;
+
+	/* Give a viewers eye render target back to the portal manager. */
+	void ReleasePortalTexture(int viewer, int eye);
+
+	/* Give every render target back to the portal manager. */
+	void ReleasePortalTextures();
+
+	/* Returns the render target shown on the portal for a viewers eye, the warped one when reprojected. */
+	class UCanvasRenderTarget2D* GetShownPortalTexture(int viewer, int eye) const;
+
+	/* Warp a viewers eye capture to its current view into the eyes reprojected render target. Returns false if it wasn't warped. */
+	bool ReprojectPortalView(int viewer, int eye);
+
+	/* Set the render target a portal material samples for an eye. NOTE: M_Portal samples RT_Portal and M_PortalVR samples RT_LeftEye or
+	 * RT_RightEye by stereo pass index, mono captures use pass index 0 so the left eye is set along with RT_Portal. */
+	static void SetMaterialEyeTexture(class UMaterialInstanceDynamic* material, int eye, class UTexture* texture);
+
+	/* Setup the portal captures clip plane at the target portal and return it. */
+	FPlane UpdateCaptureClipPlane();
+
+	/* Capture a viewers view of the portal for the given stereo pass into its render target, eSSP_FULL when not rendering in stereo.
+	 * Returns false if the portal isn't on screen for the pass or no render target could be found. */
+	bool CapturePortalView(int viewer, EStereoscopicPass pass, const FPlane& clipPlane);
+
+	/* Update the resolution a viewer renders at based on the portals coverage on its screen and distance from its camera.
+	 * NOTE: Only changes once the wanted resolution is outside of the hysteresis range. */
+	float UpdateResolution(FPortalView& view, const FBox2D& screenBounds, const FVector& cameraLocation);
+
+	/* Returns the distance from the closest viewers camera to the portal. */
+	float GetClosestViewerDistance();
+
+	/* Returns a viewers camera component, nullptr if the viewer doesn't exist. */
+	class UCameraComponent* GetViewerCamera(int viewer) const;
+
+	/* Update the captures show only list with the primitives that could be seen through the target portal.
+	 * NOTE: Non-movable primitives are only searched for again if the target portal moves or a level is streamed. */
+	void UpdateShowOnlyList();
+
+	/* Returns the capture profile for the given level of recursion. */
+	FPortalCaptureProfile GetCaptureProfile(int recursion) const;
+
+	/* Apply a capture profile to the portal capture. */
+	void ApplyCaptureProfile(const FPortalCaptureProfile& profile);
+
+	/* Is a primitive in front of the target portal plane and within destinationViewDistance of the target portal. */
+	bool IsInDestinationView(const UPrimitiveComponent* primitive, const FPlane& targetPlane, const FVector& targetLocation) const;
+
+	/* Is every viewers last capture still valid as their views and the scene in front of the target portal haven't changed since. */
+	bool IsCaptureCached();
+
+	/* Is a viewers last capture still valid as its view and the scene in front of the target portal haven't changed since. */
+	bool IsViewCached(int viewer);
+
+	/* Returns an order independent hash of the transforms of every movable primitive in front of the target portal.
+	 * NOTE: outAnimated is true if any of them are animating as the hash wouldn't change. Found once per frame for every viewer. */
+	uint32 GetDestinationHash(bool& outAnimated);
+
+	/* Updates each viewers pawn tracking for going through portals. Cannot rely on detecting overlaps. */
+	void UpdatePawnTracking();
 
 protected:
 
 	/* Level start. */
 	virtual void BeginPlay() override;
 
-	/* Delayed setup function. */
-	UFUNCTION()
-	void Setup();
+	/* Level end. */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	/* Post initialization. */
 	virtual void PostInitializeComponents() override;
 
-	/* Post physics ticking function. */
-	void PostPhysicsTick(float DeltaTime);
-
 public:
 
 	/* Constructor. */
 	APortal();
-	
-	/* Frame. */
-	virtual void Tick(float DeltaTime) override;
 
-	/* Called when the portal box is overlapped. */
-	UFUNCTION(Category = "Portal")
-	void OnPortalBoxOverlapStart(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex, bool fromSweep, const FHitResult& portalHit);
-	
-	/* Called when the portal box ends one of its overlap events. */
-	UFUNCTION(Category = "Portal")
-	void OnPortalBoxOverlapEnd(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex);
+	/* Has the target portal begun play so this portal can be setup. */
+	bool IsReadyForSetup() const;
 
-	/* Called when the portal mesh ends one of its overlap events. */
-	UFUNCTION(Category = "Portal")
-	void OnPortalMeshOverlapStart(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex, bool fromSweep, const FHitResult& portalHit);
-	
-	/* Called when the portal mesh ends one of its overlap events. */
-	UFUNCTION(Category = "Portal")
-	void OnPortalMeshOverlapEnd(UPrimitiveComponent* portalMeshHit, AActor* overlappedActor, UPrimitiveComponent* overlappedComp, int32 otherBodyIndex);
+	/* Setup the portal and register it to be updated, called by the portal manager once the portal is ready.
+	 * NOTE: Render targets and viewer views are made on first use rather than here. */
+	void Setup();
+
+	/* Post physics update for teleporting the pawns, called by the portal manager for every active portal.
+	 * NOTE: After physics as the pawns position is physics driven, also where the tracking state of the HMD and hands is checked. */
+	void PostPhysicsTick(float DeltaTime);
+
+	/* Find where a range of the tracked actors duplicates go at the target portal and which of them have crossed the portal.
+	 * NOTE: Only reads from the portal and its tracked actors so different ranges can be gathered on any thread at once. Uses the cached
+	 *       target transform as is so GetTargetTransform must be called on the game thread first. */
+	void GatherTrackedActors(FTrackedActorsUpdate& outUpdate, int32 first, int32 num) const;
+
+	/* Move the duplicates and teleport the crossed actors found by GatherTrackedActors. Game thread only.
+	 * NOTE: Takes care of teleporting physics objects as well as duplicating them and the pawn if overlapping... */
+	void ApplyTrackedActors(const FTrackedActorsUpdate& update);
+
+	/* Frame update for the portals view, called by the portal manager for every registered portal after it has found this frames
+	 * active and visible portals. NOTE: Portals don't tick themselves. */
+	void UpdatePortal(float DeltaTime);
+
+	/* Queue the simulating tracked actors to be tested for crossing the portal in the next physics substeps if substepCrossings is enabled.
+	 * NOTE: Called by the portal manager for every portal after its update, the substep callbacks only last one physics step. */
+	void QueueSubstepCrossings();
+
+	/* Build the portal box and mesh volumes for the portal managers broadphase. */
+	void GetBroadphaseProxy(FPortalBroadphaseProxy& outProxy) const;
+
+	/* Is the proxy still built from the portal box and meshes current transforms. */
+	bool IsBroadphaseProxyCurrent(const FPortalBroadphaseProxy& proxy) const;
+
+	/* Track, remove, show and hide the actors that entered or left the portal box and mesh since last frame from the portal managers broadphase.
+	 * NOTE: Called by the portal manager for every portal before the tracked actors are gathered, replacing the box and mesh overlap events. */
+	void ApplyBroadphase(const FPortalOverlaps& overlaps);
 	
 	/* Is this portal active. */
 	UFUNCTION(BlueprintCallable, Category = "Portal")
@@ -228,13 +578,61 @@ public:
 	/* Hides a copied version of an actor from the main render pass so it still casts shadows... */
 	void HideActor(AActor* actor, bool hide = true);
 
+	/* Hides or shows the duplicate of a tracked actor from the main render pass, whether its a copied actor or an instance. */
+	void HideDuplicate(AActor* actor, bool hide = true);
+
+	/* Send any moved or hidden duplicate instances to their instanced meshes. Called by the portal manager once a frame. */
+	void FlushDuplicateInstances();
+
 	/* Adds a tracked actor to the tracked actor array updated in tick. */
 	void AddTrackedActor(AActor* actorToAdd);
 
 	/* Removes a tracked actor and its duplicate. */
 	void RemoveTrackedActor(AActor* actorToRemove);
 
-	/* Update the render texture for this portal using the scene capture component. */
+	/* Is the portals view due to be updated this frame based on its update rate. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	bool IsUpdateDue();
+
+	/* Number of viewer captures skipped since begin play because nothing visible through the portal had changed, one per viewer view skipped. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	int GetSkippedCaptureCount();
+
+	/* World time the portals view was last updated. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	float GetLastUpdateTime();
+
+	/* Capture this portal as seen through other portals from the portal managers view node into a render target borrowed for the frame.
+	 * Portals seen through this one are captured first and shown in this capture. Returns the render target or nullptr if none was free.
+	 * NOTE: The portals with swapped material views and borrowed render targets are added to the arrays to be restored and released after use. */
+	class UCanvasRenderTarget2D* CaptureViewNode(int nodeIndex, const FVector& eyeLocation, const FQuat& eyeRotation, const FMatrix& projection,
+		FIntPoint size, TArray<APortal*>& swappedPortals, TArray<class UCanvasRenderTarget2D*>& borrowedTargets);
+
+	/* Update the portals view now, called by the portal manager when a requested capture fits in its budget. */
+	void ExecuteScheduledCapture();
+
+	/* Returns how important it is to update the portals view this frame from its coverage on screen, distance, recursions and time waiting. */
+	float GetCapturePriority();
+
+	/* Add a measured cost of updating the portals view to its average. */
+	void RecordCaptureCost(float milliseconds);
+
+	/* Returns the average render thread milliseconds taken to update the portals view. Zero if it hasn't been measured yet. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	float GetAverageCaptureCost();
+
+	/* Show the given texture on the portal instead of its own render target. NOTE: Used while capturing the portal from another portals view. */
+	void SetPortalMaterialView(class UTexture* texture, const FLinearColor& scaleBias);
+
+	/* Show the portals own render target again after SetPortalMaterialView. */
+	void RestorePortalMaterialView();
+
+	/* Warp each viewers last capture to its current view if the portal wasn't captured this frame. Called by the portal manager after
+	 * scheduled captures are issued. NOTE: Shows the capture unwarped when the view hasn't moved since it was taken. */
+	void UpdateReprojection();
+
+	/* Update the render texture for each viewer of this portal using the scene capture component.
+	 * NOTE: Viewers whose last capture is still valid are skipped. */
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	void UpdatePortalView();
 
@@ -242,10 +640,16 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	void ClearPortalView();
 
-	/* Updates the world offset in the dynamic material instance for the vertexes on the portal mesh when the camera gets too close.
+	/* Updates the world offset in each viewers dynamic material instance for the vertexes on the portal mesh when their camera gets too close.
 	 * NOTE: Fix for near clipping plane clipping with the portal plane mesh. */
 	void UpdateWorldOffset();
 
+	/* Get the four world space corners of the portal plane from the portal box extent. */
+	void GetPortalCorners(FVector outCorners[4]);
+
+	/* Returns the distance from the given location to the closest point on the portal plane. */
+	float GetDistanceToPortal(FVector location);
+
 	/* Is the location in-front of this portal? */
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	bool IsInfront(FVector location);
@@ -254,6 +658,9 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	FVector ConvertDirectionToTarget(FVector direction);
 
+	/* Returns the cached transform from this portal to its target portal. Refreshed if either portal has moved since it was last used. */
+	FPortalTransform& GetTargetTransform();
+
 	/* Convert a given location to the target portal. */
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	FVector ConvertLocationToPortal(FVector location, APortal* currentPortal, APortal* endPortal, bool flip = true);
@@ -270,7 +677,12 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	int GetNumberOfTrackedActors();
 
-	/* Returns the current duplicate map for this portal. All static meshes that are duplicated and tracked are added to this list. */
+	/* Returns a map from each duplicate to its tracked actor for this portal. All static meshes that are duplicated and tracked are added to this list.
+	 * NOTE: Built when called, use GetDuplicateSource to find a single actor. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	TMap<AActor*, AActor*> GetDuplicateMap();
+
+	/* Returns the tracked actor a duplicate was made from, nullptr if it isn't a duplicate made by this portal. */
 	UFUNCTION(BlueprintCallable, Category = "Portal")
-	TMap<AActor*, AActor*>& GetDuplicateMap();
+	AActor* GetDuplicateSource(AActor* duplicate);
 };
@@ -0,0 +1,1433 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "PortalManager.h"
+#include "Engine/World.h"
+#include "Engine/CanvasRenderTarget2D.h"
+#include "EngineUtils.h"
+#include "Engine/Level.h"
+#include "Components/ModelComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Materials/MaterialInterface.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
+#include "GameFramework/WorldSettings.h"
+#include "Portal.h"
+#include "PortalPlayer.h"
+#include "PortalPawn.h"
+#include "SceneView.h"
+#include "RHI.h"
+#include "RenderingThread.h"
+#include "Async/ParallelFor.h"
+
+DEFINE_LOG_CATEGORY(LogPortalManager);
+
+FIntPoint FPortalRenderTargetPool::GetBucketSize(FIntPoint size)
+{
+	// Round up to the next multiple of 128 so small changes in size don't need a new render target.
+	return FIntPoint(FMath::Max(FMath::DivideAndRoundUp(size.X, 128), 1) * 128, FMath::Max(FMath::DivideAndRoundUp(size.Y, 128), 1) * 128);
+}
+
+UCanvasRenderTarget2D* FPortalRenderTargetPool::Acquire(UObject* worldContext, FIntPoint size, float currentTime)
+{
+	// Find a free render target in the same bucket.
+	FIntPoint bucketSize = GetBucketSize(size);
+	for (FPooledRenderTarget& pooled : renderTargets)
+	{
+		if (!pooled.inUse && pooled.renderTarget && pooled.renderTarget->SizeX == bucketSize.X && pooled.renderTarget->SizeY == bucketSize.Y)
+		{
+			pooled.inUse = true;
+			pooled.lastUsedTime = currentTime;
+			return pooled.renderTarget;
+		}
+	}
+
+	// None are free so create a new one.
+	UCanvasRenderTarget2D* newTarget = UCanvasRenderTarget2D::CreateCanvasRenderTarget2D(worldContext, UCanvasRenderTarget2D::StaticClass(), bucketSize.X, bucketSize.Y);
+	if (!newTarget) return nullptr;
+	FPooledRenderTarget pooled;
+	pooled.renderTarget = newTarget;
+	pooled.inUse = true;
+	pooled.lastUsedTime = currentTime;
+	renderTargets.Add(pooled);
+	UE_LOG(LogPortalManager, Log, TEXT("Portal render target created with width: %i and height: %i, %i in pool."), bucketSize.X, bucketSize.Y, renderTargets.Num());
+	return newTarget;
+}
+
+void FPortalRenderTargetPool::Release(UCanvasRenderTarget2D* renderTarget, float currentTime)
+{
+	for (FPooledRenderTarget& pooled : renderTargets)
+	{
+		if (pooled.renderTarget == renderTarget)
+		{
+			pooled.inUse = false;
+			pooled.lastUsedTime = currentTime;
+			return;
+		}
+	}
+}
+
+void FPortalRenderTargetPool::Trim(float currentTime, float maxUnusedTime)
+{
+	// Removing the reference lets the render target be garbage collected.
+	renderTargets.RemoveAllSwap([currentTime, maxUnusedTime](const FPooledRenderTarget& pooled)
+	{
+		return !pooled.renderTarget || (!pooled.inUse && currentTime - pooled.lastUsedTime > maxUnusedTime);
+	});
+}
+
+int FPortalRenderTargetPool::GetNumInUse() const
+{
+	int numInUse = 0;
+	for (const FPooledRenderTarget& pooled : renderTargets)
+	{
+		if (pooled.inUse) numInUse++;
+	}
+	return numInUse;
+}
+
+/* Returns the static mesh of an actors root component, nullptr if it isn't a static mesh component. */
+static UStaticMesh* GetRootStaticMesh(AActor* actor)
+{
+	UStaticMeshComponent* rootMesh = Cast<UStaticMeshComponent>(actor->GetRootComponent());
+	return rootMesh ? rootMesh->GetStaticMesh() : nullptr;
+}
+
+AActor* FPortalDuplicatePool::Acquire(UObject* outer, AActor* source, float currentTime)
+{
+	// Find a free duplicate made from the same class and mesh.
+	UStaticMesh* sourceMesh = GetRootStaticMesh(source);
+	AActor* acquired = nullptr;
+	for (FPooledDuplicate& pooled : duplicates)
+	{
+		if (!pooled.inUse && pooled.duplicate && !pooled.duplicate->IsPendingKill() && pooled.duplicate->GetClass() == source->GetClass() && pooled.mesh == sourceMesh)
+		{
+			pooled.inUse = true;
+			pooled.lastUsedTime = currentTime;
+
+			// Match the materials and scale of the new source.
+			// NOTE: Components made from the same class are in the same order.
+			TInlineComponentArray<UStaticMeshComponent*> sourceMeshes(source);
+			TInlineComponentArray<UStaticMeshComponent*> duplicateMeshes(pooled.duplicate);
+			for (int i = 0; i < FMath::Min(sourceMeshes.Num(), duplicateMeshes.Num()); i++)
+			{
+				for (int material = 0; material < sourceMeshes[i]->GetNumMaterials(); material++)
+				{
+					UMaterialInterface* sourceMaterial = sourceMeshes[i]->GetMaterial(material);
+					if (duplicateMeshes[i]->GetMaterial(material) != sourceMaterial) duplicateMeshes[i]->SetMaterial(material, sourceMaterial);
+				}
+			}
+			pooled.duplicate->SetActorScale3D(source->GetActorScale3D());
+			pooled.duplicate->SetActorHiddenInGame(false);
+			pooled.duplicate->SetActorEnableCollision(true);
+			acquired = pooled.duplicate;
+			break;
+		}
+	}
+
+	// None are free so create a copy of the given actor.
+	if (!acquired) acquired = Create(outer, source, sourceMesh, currentTime, true);
+
+	// Raise the high water mark of this class and mesh. NOTE: Remembers the source to warm up the pool with.
+	FPooledDuplicateUsage* keyUsage = usage.FindByPredicate([&](const FPooledDuplicateUsage& other) { return other.actorClass == source->GetClass() && other.mesh == sourceMesh; });
+	if (!keyUsage)
+	{
+		keyUsage = &usage[usage.AddDefaulted()];
+		keyUsage->actorClass = source->GetClass();
+		keyUsage->mesh = sourceMesh;
+	}
+	keyUsage->source = source;
+	int numInUse = CountDuplicates(keyUsage->actorClass, keyUsage->mesh, true);
+	if (numInUse >= keyUsage->highWater)
+	{
+		keyUsage->highWater = numInUse;
+		keyUsage->highWaterTime = currentTime;
+	}
+	return acquired;
+}
+
+AActor* FPortalDuplicatePool::Create(UObject* outer, AActor* source, UStaticMesh* sourceMesh, float currentTime, bool inUse)
+{
+	// NOTE: CODE IS ONLY TESTED FOR STATIC MESHES AND THE PLAYER... CHECKS ROOT COMPONENT ONLY.
+	FName newActorName = MakeUniqueObjectName(outer, AActor::StaticClass(), "CoppiedActor");
+	AActor* newActor = NewObject<AActor>(outer, newActorName, RF_NoFlags, source);
+	TInlineComponentArray<UStaticMeshComponent*> foundStaticMeshes(newActor);
+	newActor->RegisterAllComponents();
+
+	// If its the player disable any important functionality.
+	if (APortalPawn* isPawn = Cast<APortalPawn>(newActor))
+	{
+		isPawn->playerCapsule->SetCollisionResponseToChannel(ECC_PortalBox, ECR_Ignore);
+		isPawn->playerCapsule->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);
+		isPawn->playerCapsule->SetSimulatePhysics(false);
+		isPawn->PrimaryActorTick.SetTickFunctionEnable(false);
+	}
+	// Else assume its a static mesh or handle other objects HERE...
+	else
+	{
+		// Make sure static meshes ignore portal to avoid duplicates of duplicates being made...
+		// NOTE: Causes an issue where the duplicate when ran into will not be moved by the player
+		// FIXED: Fix for this was to duplicate the player as-well and drive its position...
+		for (UStaticMeshComponent* staticComp : foundStaticMeshes)
+		{
+			staticComp->SetCollisionResponseToChannel(ECC_PortalBox, ECR_Ignore);
+			staticComp->SetCollisionResponseToChannel(ECC_Interactable, ECR_Ignore);
+			staticComp->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);// Ignore pawn.
+			staticComp->SetSimulatePhysics(false);
+		}
+	}
+
+	// Free duplicates are hidden until lent out.
+	if (!inUse)
+	{
+		newActor->SetActorHiddenInGame(true);
+		newActor->SetActorEnableCollision(false);
+	}
+
+	FPooledDuplicate pooled;
+	pooled.duplicate = newActor;
+	pooled.mesh = sourceMesh;
+	pooled.inUse = inUse;
+	pooled.lastUsedTime = currentTime;
+	duplicates.Add(pooled);
+	UE_LOG(LogPortalManager, Log, TEXT("Portal duplicate created for %s, %i in pool."), *source->GetName(), duplicates.Num());
+	return newActor;
+}
+
+void FPortalDuplicatePool::Release(AActor* duplicate, float currentTime)
+{
+	for (FPooledDuplicate& pooled : duplicates)
+	{
+		if (pooled.duplicate == duplicate)
+		{
+			pooled.inUse = false;
+			pooled.lastUsedTime = currentTime;
+			if (!duplicate->IsPendingKill())
+			{
+				duplicate->SetActorHiddenInGame(true);
+				duplicate->SetActorEnableCollision(false);
+			}
+			return;
+		}
+	}
+}
+
+void FPortalDuplicatePool::Trim(UWorld* world, UObject* outer, float currentTime, float maxUnusedTime, TArray<AActor*>& outCreated)
+{
+	// Lower the high water marks that haven't been reached for a while and forget the classes and meshes no longer used.
+	for (int i = usage.Num() - 1; i >= 0; i--)
+	{
+		FPooledDuplicateUsage& keyUsage = usage[i];
+		if (currentTime - keyUsage.highWaterTime > maxUnusedTime)
+		{
+			keyUsage.highWater = FMath::Max(keyUsage.highWater - 1, CountDuplicates(keyUsage.actorClass, keyUsage.mesh, true));
+			keyUsage.highWaterTime = currentTime;
+		}
+		if (keyUsage.highWater == 0) usage.RemoveAtSwap(i);
+	}
+
+	// Destroyed duplicates are left for the garbage collector to find on its own schedule.
+	for (int i = duplicates.Num() - 1; i >= 0; i--)
+	{
+		FPooledDuplicate& pooled = duplicates[i];
+		bool valid = pooled.duplicate && !pooled.duplicate->IsPendingKill();
+		if (valid && (pooled.inUse || currentTime - pooled.lastUsedTime <= maxUnusedTime)) continue;
+		if (valid)
+		{
+			UClass* actorClass = pooled.duplicate->GetClass();
+			if (CountDuplicates(actorClass, pooled.mesh, false) <= GetWarmCount(actorClass, pooled.mesh)) continue;
+			world->DestroyActor(pooled.duplicate);
+		}
+		duplicates.RemoveAtSwap(i);
+	}
+
+	// Keep a free duplicate over the high water mark so the next actor to cross doesn't create one mid-frame.
+	// NOTE: At most one per class and mesh each pass to spread the cost.
+	for (const FPooledDuplicateUsage& keyUsage : usage)
+	{
+		AActor* source = keyUsage.source.Get();
+		if (!source || source->IsPendingKill() || source->GetClass() != keyUsage.actorClass || GetRootStaticMesh(source) != keyUsage.mesh) continue;
+		if (CountDuplicates(keyUsage.actorClass, keyUsage.mesh, false) >= GetWarmCount(keyUsage.actorClass, keyUsage.mesh)) continue;
+		outCreated.Add(Create(outer, source, keyUsage.mesh, currentTime, false));
+	}
+}
+
+int FPortalDuplicatePool::CountDuplicates(UClass* actorClass, UStaticMesh* mesh, bool onlyInUse) const
+{
+	int numDuplicates = 0;
+	for (const FPooledDuplicate& pooled : duplicates)
+	{
+		if (pooled.duplicate && !pooled.duplicate->IsPendingKill() && pooled.duplicate->GetClass() == actorClass && pooled.mesh == mesh && (pooled.inUse || !onlyInUse)) numDuplicates++;
+	}
+	return numDuplicates;
+}
+
+int FPortalDuplicatePool::GetWarmCount(UClass* actorClass, UStaticMesh* mesh) const
+{
+	const FPooledDuplicateUsage* keyUsage = usage.FindByPredicate([&](const FPooledDuplicateUsage& other) { return other.actorClass == actorClass && other.mesh == mesh; });
+	return keyUsage ? keyUsage->highWater + 1 : 0;
+}
+
+int FPortalDuplicatePool::GetNumInUse() const
+{
+	int numInUse = 0;
+	for (const FPooledDuplicate& pooled : duplicates)
+	{
+		if (pooled.inUse) numInUse++;
+	}
+	return numInUse;
+}
+
+void FPortalPrimitiveGrid::Reset(float newCellSize)
+{
+	primitives.Reset();
+	primitiveBounds.Reset();
+	primitiveMinCells.Reset();
+	primitiveMaxCells.Reset();
+	primitiveIndices.Reset();
+	freeIndices.Reset();
+	cells.Reset();
+	largePrimitives.Reset();
+	cellSize = FMath::Max(newCellSize, 1.0f);
+}
+
+void FPortalPrimitiveGrid::Add(UPrimitiveComponent* primitive)
+{
+	if (!primitive || !primitive->IsRegistered() || primitiveIndices.Contains(primitive)) return;
+
+	// Reuse the index of a removed primitive if there is one.
+	int32 index;
+	if (freeIndices.Num() > 0)
+	{
+		index = freeIndices.Pop(false);
+		primitives[index] = primitive;
+	}
+	else
+	{
+		index = primitives.Add(primitive);
+		primitiveBounds.AddDefaulted();
+		primitiveMinCells.AddDefaulted();
+		primitiveMaxCells.AddDefaulted();
+	}
+	primitiveIndices.Add(primitive, index);
+	primitiveBounds[index] = primitive->Bounds.GetBox();
+	GetCells(primitiveBounds[index], primitiveMinCells[index], primitiveMaxCells[index]);
+	AddToCells(index);
+}
+
+void FPortalPrimitiveGrid::Remove(int32 index)
+{
+	if (!primitives.IsValidIndex(index) || freeIndices.Contains(index)) return;
+	RemoveFromCells(index);
+	primitiveIndices.Remove(primitives[index]);
+	primitives[index] = nullptr;
+	freeIndices.Add(index);
+}
+
+void FPortalPrimitiveGrid::UpdateMoved()
+{
+	for (int32 index = 0; index < primitives.Num(); index++)
+	{
+		UPrimitiveComponent* primitive = primitives[index].Get();
+		if (!primitive || !primitive->IsRegistered())
+		{
+			// NOTE: Free indices are already null so check the primitive was in the grid.
+			if (!primitives[index].IsExplicitlyNull()) Remove(index);
+			continue;
+		}
+		if (primitive->Mobility != EComponentMobility::Movable) continue;
+
+		// Queries test the latest bounds, the cells only change when the bounds leave them.
+		primitiveBounds[index] = primitive->Bounds.GetBox();
+		FIntVector minCell, maxCell;
+		GetCells(primitiveBounds[index], minCell, maxCell);
+		if (minCell == primitiveMinCells[index] && maxCell == primitiveMaxCells[index]) continue;
+		RemoveFromCells(index);
+		primitiveMinCells[index] = minCell;
+		primitiveMaxCells[index] = maxCell;
+		AddToCells(index);
+	}
+}
+
+void FPortalPrimitiveGrid::GetCells(const FBox& bounds, FIntVector& outMinCell, FIntVector& outMaxCell) const
+{
+	outMinCell = FIntVector(FMath::FloorToInt(bounds.Min.X / cellSize), FMath::FloorToInt(bounds.Min.Y / cellSize), FMath::FloorToInt(bounds.Min.Z / cellSize));
+	outMaxCell = FIntVector(FMath::FloorToInt(bounds.Max.X / cellSize), FMath::FloorToInt(bounds.Max.Y / cellSize), FMath::FloorToInt(bounds.Max.Z / cellSize));
+}
+
+void FPortalPrimitiveGrid::AddToCells(int32 index)
+{
+	// Add to every cell the bounds overlap unless there are too many.
+	const FIntVector& minCell = primitiveMinCells[index];
+	const FIntVector& maxCell = primitiveMaxCells[index];
+	int64 numCells = int64(maxCell.X - minCell.X + 1) * int64(maxCell.Y - minCell.Y + 1) * int64(maxCell.Z - minCell.Z + 1);
+	if (numCells > maxCellsPerPrimitive)
+	{
+		largePrimitives.Add(index);
+		return;
+	}
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				cells.FindOrAdd(FIntVector(x, y, z)).Add(index);
+			}
+		}
+	}
+}
+
+void FPortalPrimitiveGrid::RemoveFromCells(int32 index)
+{
+	const FIntVector& minCell = primitiveMinCells[index];
+	const FIntVector& maxCell = primitiveMaxCells[index];
+	int64 numCells = int64(maxCell.X - minCell.X + 1) * int64(maxCell.Y - minCell.Y + 1) * int64(maxCell.Z - minCell.Z + 1);
+	if (numCells > maxCellsPerPrimitive)
+	{
+		largePrimitives.RemoveSingleSwap(index, false);
+		return;
+	}
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				FIntVector cell = FIntVector(x, y, z);
+				TArray<int32>* cellPrimitives = cells.Find(cell);
+				if (!cellPrimitives) continue;
+				cellPrimitives->RemoveSingleSwap(index, false);
+				if (cellPrimitives->Num() == 0) cells.Remove(cell);
+			}
+		}
+	}
+}
+
+void FPortalPrimitiveGrid::Query(const FBox& box, TArray<UPrimitiveComponent*>& outPrimitives) const
+{
+	// Primitives can be in more than one cell so remember which have been added.
+	TBitArray<> added(false, primitives.Num());
+	auto addPrimitive = [&](int32 index)
+	{
+		if (added[index] || !primitiveBounds[index].Intersect(box)) return;
+		added[index] = true;
+		if (UPrimitiveComponent* primitive = primitives[index].Get()) outPrimitives.Add(primitive);
+	};
+	for (int32 index : largePrimitives) addPrimitive(index);
+
+	// Visit the cells overlapping the box, or every occupied cell if that would be fewer.
+	FIntVector minCell = FIntVector(FMath::FloorToInt(box.Min.X / cellSize), FMath::FloorToInt(box.Min.Y / cellSize), FMath::FloorToInt(box.Min.Z / cellSize));
+	FIntVector maxCell = FIntVector(FMath::FloorToInt(box.Max.X / cellSize), FMath::FloorToInt(box.Max.Y / cellSize), FMath::FloorToInt(box.Max.Z / cellSize));
+	int64 numSearchCells = int64(maxCell.X - minCell.X + 1) * int64(maxCell.Y - minCell.Y + 1) * int64(maxCell.Z - minCell.Z + 1);
+	if (numSearchCells > cells.Num())
+	{
+		for (const TPair<FIntVector, TArray<int32>>& cell : cells)
+		{
+			for (int32 index : cell.Value) addPrimitive(index);
+		}
+		return;
+	}
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				if (const TArray<int32>* cellPrimitives = cells.Find(FIntVector(x, y, z)))
+				{
+					for (int32 index : *cellPrimitives) addPrimitive(index);
+				}
+			}
+		}
+	}
+}
+
+APortalManager::APortalManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = ETickingGroup::TG_PostUpdateWork;
+
+	// Add post physics ticking function to this actor.
+	physicsTick.bCanEverTick = false;
+	physicsTick.Target = this;
+	physicsTick.TickGroup = TG_PostPhysics;
+
+	// Defaults.
+	renderTargetKeepTime = 2.0f;
+	duplicateKeepTime = 10.0f;
+	maxSetupsPerFrame = 4;
+	nextUpdatePhase = 0;
+	sceneVersion = 0;
+	portalProxiesDirty = true;
+	staticPrimitivesVersion = -1;
+	dynamicPrimitivesFrame = 0;
+	portalGridCellSize = 2000.0f;
+	manageActivation = false;
+	activationDistance = 500.0f;
+	activationCheckDirection = false;
+	activationMoveThreshold = 50.0f;
+	viewerMeshesDirty = false;
+	activationDirty = true;
+	lastTrimTime = 0.0f;
+	visibilityTraversal = true;
+	maxVisibilityDepth = 3;
+	maxVisibilityNodes = 32;
+	traversalDistance = 5000.0f;
+	scheduleCaptures = true;
+	renderThreadBudgetMs = 4.0f;
+	targetGPUFrameMs = 0.0f;
+	minCapturesPerFrame = 1;
+	budgetScale = 1.0f;
+	measuredCaptureCost = 0.0f;
+}
+
+void APortalManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Find every actor that can move from the start of the level.
+	UWorld* world = GetWorld();
+	for (TActorIterator<AActor> actor(world); actor; ++actor)
+	{
+		if (HasMovablePrimitives(*actor)) dynamicActors.Add(*actor);
+	}
+
+	// Components spawned at a location by UGameplayStatics such as emitters, decals and sounds are owned by the world settings.
+	if (AWorldSettings* worldSettings = world->GetWorldSettings()) dynamicActors.AddUnique(worldSettings);
+	dynamicPrimitives.Reset(portalGridCellSize);
+	pendingDynamicActors = dynamicActors;
+
+	// Keep track of anything spawned or streamed in later.
+	actorSpawnedHandle = world->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &APortalManager::RegisterDynamicActor));
+	levelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &APortalManager::OnLevelChanged);
+	levelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &APortalManager::OnLevelChanged);
+
+	// Issue scheduled captures once every actor has ticked.
+	postActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &APortalManager::OnWorldPostActorTick);
+
+	// Register the post physics tick function that updates every portals teleporting.
+	physicsTick.bCanEverTick = true;
+	physicsTick.RegisterTickFunction(GetLevel());
+}
+
+void APortalManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	Super::EndPlay(EndPlayReason);
+
+	// Remove delegate bindings.
+	if (UWorld* world = GetWorld()) world->RemoveOnActorSpawnedHandler(actorSpawnedHandle);
+	FWorldDelegates::LevelAddedToWorld.Remove(levelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(levelRemovedHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(postActorTickHandle);
+	physicsTick.UnRegisterTickFunction();
+}
+
+void APortalManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	// Release render targets no portal has needed for a while and remove destroyed dynamic actors.
+	float currentTime = GetWorld()->GetTimeSeconds();
+	if (currentTime - lastTrimTime >= 0.5f)
+	{
+		lastTrimTime = currentTime;
+		renderTargetPool.Trim(currentTime, renderTargetKeepTime);
+		TArray<AActor*> createdDuplicates;
+		duplicatePool.Trim(GetWorld(), this, currentTime, duplicateKeepTime, createdDuplicates);
+		for (AActor* duplicate : createdDuplicates) RegisterDynamicActor(duplicate);
+		dynamicActors.RemoveAllSwap([](const TWeakObjectPtr<AActor>& actor) { return !actor.IsValid(); });
+
+		// Check the dynamic actors again for components added since their primitives were added.
+		pendingDynamicActors = dynamicActors;
+	}
+
+	// Setup portals that began play since the last tick, before activation so they can be activated this frame.
+	if (pendingSetups.Num() > 0) UpdatePendingSetups();
+
+	// Find the local players viewing the portals and make sure each only sees its own portal meshes.
+	UpdateViewers();
+	if (viewerMeshesDirty) UpdateViewerMeshes();
+
+	// Only check portal activation once a viewers camera has changed cell, moved or turned far enough.
+	if (manageActivation || visibilityTraversal)
+	{
+		bool activationChanged = false;
+		for (int i = 0; i < viewers.Num(); i++)
+		{
+			FPortalViewer& viewer = viewers[i];
+			if (!viewer.controller->PlayerCameraManager) continue;
+			FVector cameraLocation = viewer.controller->PlayerCameraManager->GetCameraLocation();
+			FVector cameraDirection = viewer.controller->PlayerCameraManager->GetCameraRotation().Vector();
+			bool moved = FVector::DistSquared(cameraLocation, viewer.lastActivationLoc) > FMath::Square(activationMoveThreshold);
+			bool turned = activationCheckDirection && FVector::DotProduct(cameraDirection, viewer.lastActivationDir) < 0.985f;
+			if (activationDirty || moved || turned || GetGridCell(cameraLocation) != viewer.lastActivationCell)
+			{
+				UpdateActivation(i, cameraLocation, cameraDirection);
+				activationChanged = true;
+			}
+		}
+		activationDirty = false;
+
+		// NOTE: Nearby portals are activated even with the visibility traversal as portals off screen, like one the camera is
+		//       backing through, still need to track and teleport actors.
+		if (activationChanged && manageActivation)
+		{
+			TArray<APortal*> nearbyPortals;
+			for (const FPortalViewer& viewer : viewers)
+			{
+				for (APortal* portal : viewer.nearbyPortals) nearbyPortals.AddUnique(portal);
+			}
+			SetActivePortals(nearbyPortals);
+		}
+	}
+
+	// Find what is visible through the portals this frame before the portals update.
+	if (visibilityTraversal) UpdateVisibility();
+	else
+	{
+		viewNodes.Reset();
+		for (FPortalViewer& viewer : viewers) viewer.rootViewNodes.Reset();
+	}
+
+	// Send the duplicate instances moved or hidden since the last frame to their instanced meshes before any portal captures them.
+	// NOTE: Done once here for every active portal first as many portals can target the same portal. Duplicates are owned by the
+	//       target portal, inactive portals flush their target themselves.
+	for (APortal* portal : activePortals)
+	{
+		if (portal->pTargetPortal) portal->pTargetPortal->FlushDuplicateInstances();
+	}
+
+	// Update every active portal now this frames active and visible portals are known.
+	// NOTE: Indexed as a portal destroyed or deactivated during its update is removed from the array.
+	for (int i = 0; i < activePortals.Num(); i++)
+	{
+		APortal* portal = activePortals[i];
+		portal->UpdatePortal(DeltaTime);
+		if (activePortals.IsValidIndex(i) && activePortals[i] == portal) portal->QueueSubstepCrossings();
+	}
+}
+
+void APortalManager::PostPhysicsTick(float DeltaTime)
+{
+	// Find what has entered and left each portal first as it changes their tracked actors.
+	UpdateBroadphase(DeltaTime);
+
+	// Only active portals teleport. NOTE: Indexed as a portal destroyed while teleporting is removed from the array.
+	// NOTE: Split into chunks of tracked actors so a portal with many of them is spread across threads.
+	static const int32 trackedChunkSize = 32;
+	trackedChunks.Reset();
+	for (int i = 0; i < portals.Num(); i++)
+	{
+		APortal* portal = portals[i];
+		if (!portal->IsActive()) continue;
+		portal->PostPhysicsTick(DeltaTime);
+		int32 numTracked = portal->GetNumberOfTrackedActors();
+		if (numTracked == 0) continue;
+
+		// Update the cached target transform here so gathering only reads it.
+		portal->GetTargetTransform();
+		for (int32 first = 0; first < numTracked; first += trackedChunkSize)
+		{
+			trackedChunks.Add({ portal, first, FMath::Min(trackedChunkSize, numTracked - first) });
+		}
+	}
+	if (trackedChunks.Num() == 0) return;
+
+	// Find the crossed actors and duplicate transforms for every chunk at once. NOTE: Each chunk writes only to its own update.
+	if (trackedUpdates.Num() < trackedChunks.Num()) trackedUpdates.SetNum(trackedChunks.Num());
+	ParallelFor(trackedChunks.Num(), [this](int32 i)
+	{
+		const FTrackedActorsChunk& chunk = trackedChunks[i];
+		chunk.portal->GatherTrackedActors(trackedUpdates[i], chunk.first, chunk.num);
+	}, trackedChunks.Num() == 1);
+
+	// Move and teleport on the game thread in the same order as the chunks were gathered.
+	// NOTE: Updates find tracked actors by handle so a chunks teleports don't affect the later chunks of the same portal.
+	for (int i = 0; i < trackedChunks.Num(); i++)
+	{
+		APortal* portal = trackedChunks[i].portal;
+		if (!portal->IsPendingKill()) portal->ApplyTrackedActors(trackedUpdates[i]);
+	}
+}
+
+void APortalManager::UpdateBroadphase(float DeltaTime)
+{
+	// Every portals volumes. NOTE: Only rebuilt for the portals that have moved, or every portal when portals are added or removed.
+	bool rebuildProxies = portalProxiesDirty || portalProxies.Num() != portals.Num();
+	portalProxiesDirty = false;
+	if (rebuildProxies)
+	{
+		portalProxies.SetNum(portals.Num(), false);
+		portalProxyIndices.Reset();
+	}
+	for (int i = 0; i < portals.Num(); i++)
+	{
+		APortal* portal = portals[i];
+		if (!rebuildProxies && portal->IsBroadphaseProxyCurrent(portalProxies[i])) continue;
+		portal->GetBroadphaseProxy(portalProxies[i]);
+		portalProxyIndices.Add(portal, i);
+
+		// Move the portal in the grid if its volumes have left the bounds it was added with.
+		// NOTE: Grown to the portal box as well as its mesh so bodies entering the box are found from the grid.
+		FBox* bounds = portalBounds.Find(portal);
+		if (bounds && !bounds->IsInside(portalProxies[i].bounds))
+		{
+			RemoveFromPortalGrid(portal, *bounds);
+			*bounds = portalProxies[i].bounds;
+			AddToPortalGrid(portal, *bounds);
+		}
+	}
+
+	// Every physics body that can pass through a portal. NOTE: Same as the portal box collision profile, bodies ignoring its channel don't teleport
+	//       and neither do bodies whose object type the portal box ignores, checked per portal below.
+	broadphaseBodies.Reset();
+	for (const TWeakObjectPtr<AActor>& dynamicActor : dynamicActors)
+	{
+		AActor* actor = dynamicActor.Get();
+		UPrimitiveComponent* rootComp = actor ? Cast<UPrimitiveComponent>(actor->GetRootComponent()) : nullptr;
+		if (!rootComp || !rootComp->IsSimulatingPhysics() || rootComp->GetCollisionResponseToChannel(ECC_PortalBox) == ECR_Ignore) continue;
+
+		// Swept back along its velocity to where it was last frame.
+		FVector lastOffset = rootComp->GetPhysicsLinearVelocity() * -DeltaTime;
+		FBroadphaseBody& body = broadphaseBodies[broadphaseBodies.AddDefaulted()];
+		body.actor = actor;
+		body.objectType = rootComp->GetCollisionObjectType();
+		body.lastOrigin = rootComp->GetComponentLocation() + lastOffset;
+		body.bounds = rootComp->Bounds.GetBox();
+		body.sweptBounds = body.bounds + body.bounds.ShiftBy(lastOffset);
+	}
+
+	// Test every body against the portals in the grid cells its swept bounds overlap at once. NOTE: Each body writes only to its own results.
+	ParallelFor(broadphaseBodies.Num(), [this](int32 i)
+	{
+		FBroadphaseBody& body = broadphaseBodies[i];
+		body.portalBoxes.Reset();
+		body.portalMeshes.Reset();
+		FVector sweptCenter, sweptExtent, center, extent;
+		body.sweptBounds.GetCenterAndExtents(sweptCenter, sweptExtent);
+		body.bounds.GetCenterAndExtents(center, extent);
+		TArray<int32, TInlineAllocator<8>> nearbyProxies;
+		FindPortalProxies(body.sweptBounds, nearbyProxies);
+		for (int32 portal : nearbyProxies)
+		{
+			const FPortalBroadphaseProxy& proxy = portalProxies[portal];
+			if (!proxy.bounds.Intersect(body.sweptBounds)) continue;
+			bool boxResponds = proxy.boxResponses.GetResponse(body.objectType) != ECR_Ignore;
+			if (boxResponds && FPortalMath::OverlapsOrientedBox(proxy.boxTransform, proxy.boxExtent, sweptCenter, sweptExtent)) body.portalBoxes.Add(portal);
+			if (FPortalMath::OverlapsOrientedBox(proxy.meshTransform, proxy.meshExtent, center, extent)) body.portalMeshes.Add(portal);
+		}
+	}, broadphaseBodies.Num() < 32);
+
+	// Sort the results into each portal then give them to the portals.
+	// NOTE: Indexed as a portal destroyed while applying is removed from the array.
+	portalOverlaps.SetNum(portalProxies.Num(), false);
+	for (FPortalOverlaps& overlaps : portalOverlaps) overlaps.Reset();
+	for (const FBroadphaseBody& body : broadphaseBodies)
+	{
+		for (int32 portal : body.portalBoxes)
+		{
+			portalOverlaps[portal].boxActors.Add(body.actor);
+			portalOverlaps[portal].boxOrigins.Add(body.lastOrigin);
+		}
+		for (int32 portal : body.portalMeshes) portalOverlaps[portal].meshActors.Add(body.actor);
+	}
+	for (int i = 0; i < portals.Num() && i < portalOverlaps.Num(); i++)
+	{
+		portals[i]->ApplyBroadphase(portalOverlaps[i]);
+	}
+}
+
+void APortalManager::UpdateViewers()
+{
+	// Every local player with a portal pawn views the portals. NOTE: Ordered by the worlds player controllers so the first player is viewer 0.
+	int numViewers = 0;
+	for (FConstPlayerControllerIterator iterator = GetWorld()->GetPlayerControllerIterator(); iterator; ++iterator)
+	{
+		APlayerController* PC = iterator->Get();
+		if (!PC || !PC->IsLocalController()) continue;
+		UPortalPlayer* portalPlayer = Cast<UPortalPlayer>(PC->GetLocalPlayer());
+		APortalPawn* pawn = Cast<APortalPawn>(PC->GetPawn());
+		if (!portalPlayer || !pawn) continue;
+
+		// Keep the viewers activation state unless a different player has taken its place.
+		if (!viewers.IsValidIndex(numViewers)) viewers.AddDefaulted();
+		FPortalViewer& viewer = viewers[numViewers++];
+		if (viewer.controller != PC || viewer.pawn != pawn)
+		{
+			viewer = FPortalViewer();
+			viewer.controller = PC;
+			viewer.player = portalPlayer;
+			viewer.pawn = pawn;
+			viewerMeshesDirty = true;
+			activationDirty = true;
+		}
+	}
+	if (viewers.Num() != numViewers)
+	{
+		viewers.SetNum(numViewers);
+		viewerMeshesDirty = true;
+		activationDirty = true;
+	}
+}
+
+void APortalManager::UpdateViewerMeshes()
+{
+	viewerMeshesDirty = false;
+
+	// Remove destroyed meshes and rebuild the meshes hidden from portal captures.
+	TSet<UPrimitiveComponent*> managedMeshes;
+	captureHiddenMeshes.Reset();
+	for (int i = 0; i < viewerMeshes.Num(); i++)
+	{
+		viewerMeshes[i].RemoveAllSwap([](const TWeakObjectPtr<UPrimitiveComponent>& mesh) { return !mesh.IsValid(); });
+		for (const TWeakObjectPtr<UPrimitiveComponent>& mesh : viewerMeshes[i])
+		{
+			managedMeshes.Add(mesh.Get());
+			if (i > 0) captureHiddenMeshes.Add(mesh);
+		}
+	}
+
+	// Each viewer only sees the portals through its own meshes. NOTE: A single viewer sees every portals own mesh so nothing needs hiding.
+	for (int i = 0; i < viewers.Num(); i++)
+	{
+		TArray<TWeakObjectPtr<UPrimitiveComponent>>& hiddenComponents = viewers[i].controller->HiddenPrimitiveComponents;
+		hiddenComponents.RemoveAllSwap([&](const TWeakObjectPtr<UPrimitiveComponent>& mesh) { return !mesh.IsValid() || managedMeshes.Contains(mesh.Get()); });
+		if (viewers.Num() <= 1) continue;
+		for (int j = 0; j < viewerMeshes.Num(); j++)
+		{
+			if (j != i) hiddenComponents.Append(viewerMeshes[j]);
+		}
+	}
+}
+
+int APortalManager::GetNumViewers() const
+{
+	return viewers.Num();
+}
+
+void APortalManager::RegisterViewerMesh(int viewer, UPrimitiveComponent* mesh)
+{
+	if (!mesh || viewer < 0) return;
+	if (!viewerMeshes.IsValidIndex(viewer)) viewerMeshes.SetNum(viewer + 1);
+	viewerMeshes[viewer].AddUnique(mesh);
+	viewerMeshesDirty = true;
+}
+
+void APortalManager::UnregisterViewerMesh(int viewer, UPrimitiveComponent* mesh)
+{
+	if (!viewerMeshes.IsValidIndex(viewer)) return;
+	viewerMeshes[viewer].RemoveSwap(mesh);
+	viewerMeshesDirty = true;
+}
+
+APortalManager* APortalManager::Get(UWorld* world)
+{
+	if (!world) return nullptr;
+
+	// Return the existing manager.
+	for (TActorIterator<APortalManager> manager(world); manager; ++manager)
+	{
+		if (!manager->IsPendingKill()) return *manager;
+	}
+
+	// Otherwise spawn one.
+	FActorSpawnParameters spawnParams;
+	spawnParams.ObjectFlags |= RF_Transient;
+	spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	return world->SpawnActor<APortalManager>(spawnParams);
+}
+
+UCanvasRenderTarget2D* APortalManager::AcquireRenderTarget(FIntPoint size)
+{
+	return renderTargetPool.Acquire(this, size, GetWorld()->GetTimeSeconds());
+}
+
+void APortalManager::ReleaseRenderTarget(UCanvasRenderTarget2D* renderTarget)
+{
+	if (renderTarget) renderTargetPool.Release(renderTarget, GetWorld()->GetTimeSeconds());
+}
+
+AActor* APortalManager::AcquireDuplicate(AActor* source)
+{
+	if (!source) return nullptr;
+	float currentTime = GetWorld()->GetTimeSeconds();
+	int numPooled = duplicatePool.duplicates.Num();
+	AActor* duplicate = duplicatePool.Acquire(this, source, currentTime);
+
+	// Duplicates aren't spawned so make sure portals know they can be seen.
+	if (duplicatePool.duplicates.Num() != numPooled) RegisterDynamicActor(duplicate);
+	return duplicate;
+}
+
+void APortalManager::ReleaseDuplicate(AActor* duplicate)
+{
+	if (duplicate) duplicatePool.Release(duplicate, GetWorld()->GetTimeSeconds());
+}
+
+int APortalManager::GetNextUpdatePhase()
+{
+	return nextUpdatePhase++;
+}
+
+void APortalManager::RegisterDynamicActor(AActor* actor)
+{
+	if (!actor || actor == this) return;
+	int32 numDynamic = dynamicActors.Num();
+	dynamicActors.AddUnique(actor);
+	if (dynamicActors.Num() != numDynamic) pendingDynamicActors.Add(actor);
+}
+
+void APortalManager::OnLevelChanged(ULevel* level, UWorld* world)
+{
+	if (world == GetWorld())
+	{
+		// Streamed in levels can contain movable actors.
+		if (level)
+		{
+			for (AActor* actor : level->Actors)
+			{
+				if (actor && HasMovablePrimitives(actor)) RegisterDynamicActor(actor);
+			}
+		}
+		sceneVersion++;
+	}
+}
+
+bool APortalManager::HasMovablePrimitives(AActor* actor)
+{
+	TInlineComponentArray<UPrimitiveComponent*> primitives;
+	actor->GetComponents(primitives);
+	for (UPrimitiveComponent* primitive : primitives)
+	{
+		if (primitive->Mobility == EComponentMobility::Movable) return true;
+	}
+	return false;
+}
+
+void APortalManager::RequestSetup(APortal* portal)
+{
+	if (portal) pendingSetups.AddUnique(portal);
+}
+
+void APortalManager::CancelSetup(APortal* portal)
+{
+	pendingSetups.Remove(portal);
+}
+
+void APortalManager::UpdatePendingSetups()
+{
+	// Setup in the order the portals began play, skipping any still waiting on their target portal.
+	// NOTE: A portal removed from the level while waiting is dropped.
+	int numSetup = 0;
+	for (int i = 0; i < pendingSetups.Num() && numSetup < maxSetupsPerFrame;)
+	{
+		APortal* portal = pendingSetups[i];
+		if (!portal || portal->IsPendingKill())
+		{
+			pendingSetups.RemoveAt(i);
+			continue;
+		}
+		if (!portal->IsReadyForSetup())
+		{
+			i++;
+			continue;
+		}
+		pendingSetups.RemoveAt(i);
+		portal->Setup();
+		numSetup++;
+	}
+}
+
+void APortalManager::RegisterPortal(APortal* portal)
+{
+	if (!portal || portalBounds.Contains(portal)) return;
+
+	// Add the portal to every cell its bounds overlap.
+	FBox bounds = portal->portalMesh->Bounds.GetBox();
+	portalBounds.Add(portal, bounds);
+	portals.Add(portal);
+	portalProxiesDirty = true;
+	RegisterViewerMesh(0, portal->portalMesh);
+	AddToPortalGrid(portal, bounds);
+
+	// Portals stay inactive until they are found near the camera.
+	if (manageActivation) portal->SetActive(false);
+	OnPortalActiveChanged(portal);
+	activationDirty = true;
+}
+
+void APortalManager::UnregisterPortal(APortal* portal)
+{
+	FBox bounds;
+	if (!portalBounds.RemoveAndCopyValue(portal, bounds)) return;
+
+	// Remove the portal from every cell it was added to.
+	RemoveFromPortalGrid(portal, bounds);
+	portals.RemoveSwap(portal);
+	activePortals.RemoveSwap(portal);
+	portalProxiesDirty = true;
+	UnregisterViewerMesh(0, portal->portalMesh);
+	for (FPortalViewer& viewer : viewers)
+	{
+		viewer.nearbyPortals.RemoveSwap(portal);
+		viewer.rootViewNodes.Remove(portal);
+	}
+}
+
+void APortalManager::AddToPortalGrid(APortal* portal, const FBox& bounds)
+{
+	FIntVector minCell = GetGridCell(bounds.Min);
+	FIntVector maxCell = GetGridCell(bounds.Max);
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				portalGrid.FindOrAdd(FIntVector(x, y, z)).Add(portal);
+			}
+		}
+	}
+}
+
+void APortalManager::RemoveFromPortalGrid(APortal* portal, const FBox& bounds)
+{
+	FIntVector minCell = GetGridCell(bounds.Min);
+	FIntVector maxCell = GetGridCell(bounds.Max);
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				FIntVector cell = FIntVector(x, y, z);
+				if (TArray<APortal*>* cellPortals = portalGrid.Find(cell))
+				{
+					cellPortals->RemoveSwap(portal);
+					if (cellPortals->Num() == 0) portalGrid.Remove(cell);
+				}
+			}
+		}
+	}
+}
+
+void APortalManager::FindPortalProxies(const FBox& box, TArray<int32, TInlineAllocator<8>>& outProxies) const
+{
+	outProxies.Reset();
+	FIntVector minCell = GetGridCell(box.Min);
+	FIntVector maxCell = GetGridCell(box.Max);
+
+	// Every proxy if the box covers more cells than are occupied.
+	int64 numSearchCells = int64(maxCell.X - minCell.X + 1) * int64(maxCell.Y - minCell.Y + 1) * int64(maxCell.Z - minCell.Z + 1);
+	if (numSearchCells > portalGrid.Num())
+	{
+		for (int32 i = 0; i < portalProxies.Num(); i++) outProxies.Add(i);
+		return;
+	}
+
+	// Otherwise the portals in the cells overlapping the box. NOTE: A portal can be in more than one cell.
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				const TArray<APortal*>* cellPortals = portalGrid.Find(FIntVector(x, y, z));
+				if (!cellPortals) continue;
+				for (APortal* portal : *cellPortals)
+				{
+					if (const int32* proxyIndex = portalProxyIndices.Find(portal)) outProxies.AddUnique(*proxyIndex);
+				}
+			}
+		}
+	}
+	outProxies.Sort();
+}
+
+void APortalManager::GetPortalsInRadius(const FVector& location, float radius, TArray<APortal*>& outPortals) const
+{
+	outPortals.Reset();
+	FBox searchBox = FBox(location - FVector(radius), location + FVector(radius));
+	FIntVector minCell = GetGridCell(searchBox.Min);
+	FIntVector maxCell = GetGridCell(searchBox.Max);
+	float radiusSquared = FMath::Square(radius);
+
+	// Check the portals within a cell against the radius.
+	auto addCellPortals = [&](const TArray<APortal*>& cellPortals)
+	{
+		for (APortal* portal : cellPortals)
+		{
+			const FBox* bounds = portalBounds.Find(portal);
+			if (bounds && bounds->ComputeSquaredDistanceToPoint(location) <= radiusSquared) outPortals.AddUnique(portal);
+		}
+	};
+
+	// Visit the cells overlapping the search box, or every occupied cell if that would be fewer.
+	int64 numSearchCells = int64(maxCell.X - minCell.X + 1) * int64(maxCell.Y - minCell.Y + 1) * int64(maxCell.Z - minCell.Z + 1);
+	if (numSearchCells > portalGrid.Num())
+	{
+		for (const TPair<FIntVector, TArray<APortal*>>& cell : portalGrid)
+		{
+			addCellPortals(cell.Value);
+		}
+		return;
+	}
+	for (int x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				if (const TArray<APortal*>* cellPortals = portalGrid.Find(FIntVector(x, y, z))) addCellPortals(*cellPortals);
+			}
+		}
+	}
+}
+
+FIntVector APortalManager::GetGridCell(const FVector& location) const
+{
+	float cellSize = FMath::Max(portalGridCellSize, 1.0f);
+	return FIntVector(FMath::FloorToInt(location.X / cellSize), FMath::FloorToInt(location.Y / cellSize), FMath::FloorToInt(location.Z / cellSize));
+}
+
+const FPortalPrimitiveGrid& APortalManager::GetStaticPrimitives()
+{
+	if (staticPrimitivesVersion == sceneVersion) return staticPrimitives;
+	staticPrimitivesVersion = sceneVersion;
+	staticPrimitives.Reset(portalGridCellSize);
+
+	// Dynamic actors are in the dynamic grid instead.
+	TSet<AActor*> dynamicActorSet;
+	for (const TWeakObjectPtr<AActor>& dynamicActor : dynamicActors)
+	{
+		if (dynamicActor.IsValid()) dynamicActorSet.Add(dynamicActor.Get());
+	}
+
+	// Every other actors primitives and the levels BSP.
+	UWorld* world = GetWorld();
+	TInlineComponentArray<UPrimitiveComponent*> primitives;
+	for (TActorIterator<AActor> actor(world); actor; ++actor)
+	{
+		if (dynamicActorSet.Contains(*actor)) continue;
+		actor->GetComponents(primitives);
+		for (UPrimitiveComponent* primitive : primitives) staticPrimitives.Add(primitive);
+	}
+	for (ULevel* level : world->GetLevels())
+	{
+		if (!level) continue;
+		for (UModelComponent* modelComp : level->ModelComponents) staticPrimitives.Add(modelComp);
+	}
+	return staticPrimitives;
+}
+
+const FPortalPrimitiveGrid& APortalManager::GetDynamicPrimitives()
+{
+	if (dynamicPrimitivesFrame == GFrameCounter) return dynamicPrimitives;
+	dynamicPrimitivesFrame = GFrameCounter;
+
+	// Add the primitives of the actors registered since the last update. NOTE: Primitives already in the grid are skipped.
+	TInlineComponentArray<UPrimitiveComponent*> primitives;
+	for (const TWeakObjectPtr<AActor>& dynamicActor : pendingDynamicActors)
+	{
+		AActor* actor = dynamicActor.Get();
+		if (!actor) continue;
+		actor->GetComponents(primitives);
+		for (UPrimitiveComponent* primitive : primitives) dynamicPrimitives.Add(primitive);
+	}
+	pendingDynamicActors.Reset();
+
+	// Only move the primitives whose bounds left their cells instead of rebuilding the grid.
+	dynamicPrimitives.UpdateMoved();
+	return dynamicPrimitives;
+}
+
+void APortalManager::RequestActivationUpdate()
+{
+	activationDirty = true;
+}
+
+void APortalManager::UpdateActivation(int viewer, const FVector& cameraLocation, const FVector& cameraDirection)
+{
+	FPortalViewer& portalViewer = viewers[viewer];
+	portalViewer.lastActivationCell = GetGridCell(cameraLocation);
+	portalViewer.lastActivationLoc = cameraLocation;
+	portalViewer.lastActivationDir = cameraDirection;
+
+	// Find the portals near the camera that it is in-front of and optionally facing.
+	// NOTE: This is only an example of how the portals can be made less of an impact to performance.
+	TArray<APortal*> foundPortals;
+	GetPortalsInRadius(cameraLocation, activationDistance, foundPortals);
+	TArray<APortal*>& nearbyPortals = portalViewer.nearbyPortals;
+	nearbyPortals.Reset();
+	for (APortal* portal : foundPortals)
+	{
+		if (!IsValid(portal)) continue;
+		float portalDistance = portal->GetDistanceToPortal(cameraLocation);
+		if (portalDistance > activationDistance || !portal->IsInfront(cameraLocation)) continue;
+		// NOTE: Portals close enough to be crossed before activation is checked again skip the direction check so the camera can back through them.
+		if (activationCheckDirection && portalDistance > activationMoveThreshold)
+		{
+			// Compare the cosine of the angle between the camera and the back of the portal instead of the angle.
+			float maxAngle = portalDistance <= 1000.0f ? 130.0f : 90.0f;
+			if (FVector::DotProduct(cameraDirection, -portal->GetActorForwardVector()) <= FMath::Cos(FMath::DegreesToRadians(maxAngle))) continue;
+		}
+		nearbyPortals.Add(portal);
+	}
+
+	// Closest first so the closest portals are kept when the visibility node budget runs out.
+	nearbyPortals.Sort([&cameraLocation](const APortal& a, const APortal& b)
+	{
+		return FVector::DistSquared(cameraLocation, a.GetActorLocation()) < FVector::DistSquared(cameraLocation, b.GetActorLocation());
+	});
+}
+
+void APortalManager::SetActivePortals(TArray<APortal*>& newActivePortals)
+{
+	// Deactivate portals that are no longer needed and activate the new ones.
+	// NOTE: Portals add and remove themselves from the active portals as they change so the last active portals are copied.
+	TArray<APortal*> lastActivePortals = activePortals;
+	for (APortal* portal : lastActivePortals)
+	{
+		if (IsValid(portal) && !newActivePortals.Contains(portal)) portal->SetActive(false);
+	}
+	for (APortal* portal : newActivePortals)
+	{
+		if (!portal->IsActive()) portal->SetActive(true);
+	}
+}
+
+void APortalManager::OnPortalActiveChanged(APortal* portal)
+{
+	if (!portalBounds.Contains(portal)) return;
+	if (portal->IsActive()) activePortals.AddUnique(portal);
+	else activePortals.RemoveSwap(portal);
+}
+
+void APortalManager::UpdateVisibility()
+{
+	viewNodes.Reset();
+
+	// Get each viewers camera and start with the portals on screen from it.
+	TArray<FSceneViewProjectionData, TInlineAllocator<4>> viewerProjections;
+	TArray<FQuat, TInlineAllocator<4>> viewerRotations;
+	TArray<bool, TInlineAllocator<4>> viewerValid;
+	viewerProjections.SetNum(viewers.Num());
+	viewerRotations.SetNum(viewers.Num());
+	viewerValid.Init(false, viewers.Num());
+	for (int v = 0; v < viewers.Num(); v++)
+	{
+		FPortalViewer& viewer = viewers[v];
+		viewer.rootViewNodes.Reset();
+		if (!viewer.controller->PlayerCameraManager || !viewer.player->GetCameraProjectionData(EStereoscopicPass::eSSP_FULL, viewerProjections[v])) continue;
+		viewerRotations[v] = viewer.controller->PlayerCameraManager->GetCameraRotation().Quaternion();
+		viewerValid[v] = true;
+	}
+
+	// Take turns between viewers adding their nearby portals so each gets a fair share of the node budget.
+	// NOTE: Nearby portals are sorted closest first so every viewer keeps the portals closest to it when the budget runs out.
+	bool portalsLeft = true;
+	for (int p = 0; portalsLeft && viewNodes.Num() < maxVisibilityNodes; p++)
+	{
+		portalsLeft = false;
+		for (int v = 0; v < viewers.Num() && viewNodes.Num() < maxVisibilityNodes; v++)
+		{
+			FPortalViewer& viewer = viewers[v];
+			if (!viewerValid[v] || p >= viewer.nearbyPortals.Num()) continue;
+			portalsLeft = true;
+			APortal* portal = viewer.nearbyPortals[p];
+			const FSceneViewProjectionData& projectionData = viewerProjections[v];
+			int nodeIndex = AddViewNode(portal, v, INDEX_NONE, FTransform::Identity, projectionData.ViewOrigin, viewerRotations[v],
+				projectionData.ProjectionMatrix, projectionData.GetConstrainedViewRect().Size());
+			if (nodeIndex != INDEX_NONE) viewer.rootViewNodes.Add(portal, nodeIndex);
+		}
+	}
+
+	// Breadth first through each visible portal so shallower portals are found first when the node budget runs out.
+	// NOTE: The portals near each target portal are shared between viewers looking through the same portal.
+	TMap<APortal*, TArray<APortal*>> targetCandidates;
+	for (int i = 0; i < viewNodes.Num() && viewNodes.Num() < maxVisibilityNodes; i++)
+	{
+		if (viewNodes[i].depth >= maxVisibilityDepth) continue;
+		APortal* portal = viewNodes[i].portal;
+		int viewer = viewNodes[i].viewer;
+		const FSceneViewProjectionData& projectionData = viewerProjections[viewer];
+		FTransform childViewTransform = viewNodes[i].viewTransform * portal->GetTargetTransform().GetTransform();
+		TArray<APortal*>* candidates = targetCandidates.Find(portal);
+		if (!candidates)
+		{
+			candidates = &targetCandidates.Add(portal);
+			GetPortalsInRadius(portal->pTargetPortal->GetActorLocation(), traversalDistance, *candidates);
+		}
+		for (APortal* candidate : *candidates)
+		{
+			// Portals seen through themselves from the camera are handled by their own recursion.
+			if (viewNodes.Num() >= maxVisibilityNodes) break;
+			if (viewNodes[i].depth == 0 && candidate == portal) continue;
+			int nodeIndex = AddViewNode(candidate, viewer, i, childViewTransform, projectionData.ViewOrigin, viewerRotations[viewer],
+				projectionData.ProjectionMatrix, projectionData.GetConstrainedViewRect().Size());
+			if (nodeIndex != INDEX_NONE) viewNodes[i].children.Add(nodeIndex);
+		}
+	}
+}
+
+int APortalManager::AddViewNode(APortal* portal, int viewer, int parent, const FTransform& viewTransform, const FVector& cameraLocation, const FQuat& cameraRotation,
+	const FMatrix& projection, FIntPoint viewSize)
+{
+	if (!IsValid(portal) || !portal->pTargetPortal) return INDEX_NONE;
+
+	// The view must be in-front of the portal.
+	FVector viewLocation = viewTransform.TransformPositionNoScale(cameraLocation);
+	FQuat viewRotation = viewTransform.GetRotation() * cameraRotation;
+	if (!portal->IsInfront(viewLocation)) return INDEX_NONE;
+
+	// Portals behind the target portal of the parent are clipped out of its view.
+	FVector portalCorners[4];
+	portal->GetPortalCorners(portalCorners);
+	FBox2D parentBounds = FBox2D(FVector2D(0.0f, 0.0f), FVector2D(1.0f, 1.0f));
+	if (parent != INDEX_NONE)
+	{
+		APortal* parentTarget = viewNodes[parent].portal->pTargetPortal;
+		FPlane parentClipPlane = FPlane(parentTarget->portalMesh->GetComponentLocation(), parentTarget->portalMesh->GetForwardVector());
+		bool anyInfront = false;
+		for (int i = 0; i < 4 && !anyInfront; i++) anyInfront = parentClipPlane.PlaneDot(portalCorners[i]) > 0.0f;
+		if (!anyInfront) return INDEX_NONE;
+		parentBounds = viewNodes[parent].screenBounds;
+	}
+
+	// Clip the portals bounds on screen by the portal its seen through and check its big enough to render.
+	FBox2D screenBounds;
+	FMatrix viewProjection = FPortalMath::MakeViewProjectionMatrix(viewLocation, viewRotation, projection);
+	if (!FPortalMath::GetScreenBounds(viewProjection, portalCorners, 4, screenBounds)) return INDEX_NONE;
+	screenBounds.Min = FVector2D(FMath::Max(screenBounds.Min.X, parentBounds.Min.X), FMath::Max(screenBounds.Min.Y, parentBounds.Min.Y));
+	screenBounds.Max = FVector2D(FMath::Min(screenBounds.Max.X, parentBounds.Max.X), FMath::Min(screenBounds.Max.Y, parentBounds.Max.Y));
+	FVector2D visiblePixels = (screenBounds.Max - screenBounds.Min) * FVector2D(viewSize.X, viewSize.Y);
+	if (visiblePixels.X <= 0.0f || visiblePixels.Y <= 0.0f || visiblePixels.X * visiblePixels.Y < portal->recursionPixelThreshold) return INDEX_NONE;
+
+	// Add the node.
+	FPortalViewNode node;
+	node.portal = portal;
+	node.viewer = viewer;
+	node.parent = parent;
+	node.depth = parent != INDEX_NONE ? viewNodes[parent].depth + 1 : 0;
+	node.viewTransform = viewTransform;
+	node.screenBounds = screenBounds;
+	return viewNodes.Add(node);
+}
+
+int APortalManager::FindRootViewNode(int viewer, APortal* portal) const
+{
+	if (!viewers.IsValidIndex(viewer)) return INDEX_NONE;
+	const int* nodeIndex = viewers[viewer].rootViewNodes.Find(portal);
+	return nodeIndex ? *nodeIndex : INDEX_NONE;
+}
+
+int APortalManager::GetNumViewNodes() const
+{
+	return viewNodes.Num();
+}
+
+void APortalManager::OnWorldPostActorTick(UWorld* world, ELevelTick tickType, float deltaTime)
+{
+	if (world != GetWorld() || tickType == LEVELTICK_TimeOnly) return;
+	IssueCaptures();
+
+	// Warp the views of portals that weren't captured this frame now every capture for the frame has been issued.
+	for (APortal* portal : activePortals) portal->UpdateReprojection();
+}
+
+void APortalManager::RequestCapture(APortal* portal, bool urgent)
+{
+	captureRequests.AddUnique(portal);
+	if (urgent) urgentCaptureRequests.AddUnique(portal);
+}
+
+void APortalManager::IssueCaptures()
+{
+	int totalDeferred = captureStats.totalDeferred;
+	captureStats = FPortalCaptureStats();
+	captureStats.totalDeferred = totalDeferred;
+	captureStats.requested = captureRequests.Num();
+
+	// Shrink the budget while the GPU is over its target frame time and grow it back while its under.
+	if (targetGPUFrameMs > 0.0f)
+	{
+		float gpuFrameMs = FPlatformTime::ToMilliseconds(GGPUFrameTime);
+		budgetScale = gpuFrameMs > targetGPUFrameMs ? FMath::Max(budgetScale * 0.9f, 0.1f) : FMath::Min(budgetScale * 1.05f, 1.0f);
+	}
+	else budgetScale = 1.0f;
+	captureStats.budgetMs = renderThreadBudgetMs * budgetScale;
+
+	// Read back the render thread cost of the captures the render thread has finished since they were issued.
+	for (int i = captureTimers.Num() - 1; i >= 0; i--)
+	{
+		FPortalCaptureTimer& timer = captureTimers[i].Get();
+		if (!timer.finished) continue;
+		if (APortal* portal = timer.portal.Get()) portal->RecordCaptureCost(timer.milliseconds);
+		measuredCaptureCost = measuredCaptureCost <= 0.0f ? timer.milliseconds : FMath::Lerp(measuredCaptureCost, timer.milliseconds, 0.1f);
+		captureTimers.RemoveAtSwap(i, 1, false);
+	}
+
+	// Portals that haven't been measured yet cost the mean of the measured portals, or an even share of the budget before any are measured.
+	// NOTE: So a burst of new portals on the first frame or after activating many at once can't all be issued in one frame.
+	float unmeasuredCost = measuredCaptureCost > 0.0f ? measuredCaptureCost : renderThreadBudgetMs / FMath::Max(minCapturesPerFrame, 1);
+	if (captureRequests.Num() == 0) return;
+
+	// Sort the requests by priority, urgent requests first.
+	TArray<TPair<float, APortal*>> prioritised;
+	for (APortal* portal : captureRequests)
+	{
+		if (!IsValid(portal) || !portal->IsActive()) continue;
+		float priority = urgentCaptureRequests.Contains(portal) ? MAX_flt : portal->GetCapturePriority();
+		prioritised.Add(TPair<float, APortal*>(priority, portal));
+	}
+	captureRequests.Reset();
+	prioritised.Sort([](const TPair<float, APortal*>& a, const TPair<float, APortal*>& b) { return a.Key > b.Key; });
+
+	// Issue captures while their measured cost fits. Deferred portals keep their request and ask again next frame.
+	float currentTime = GetWorld()->GetTimeSeconds();
+	for (const TPair<float, APortal*>& request : prioritised)
+	{
+		APortal* portal = request.Value;
+		float estimatedCost = portal->GetAverageCaptureCost() > 0.0f ? portal->GetAverageCaptureCost() : unmeasuredCost;
+		if (!urgentCaptureRequests.Contains(portal) && captureStats.issued >= minCapturesPerFrame && captureStats.usedMs + estimatedCost > captureStats.budgetMs)
+		{
+			captureStats.deferred++;
+			captureStats.oldestDeferredTime = FMath::Max(captureStats.oldestDeferredTime, currentTime - portal->GetLastUpdateTime());
+			continue;
+		}
+
+		// Time the render commands the capture queues on the render thread so the next estimate adapts.
+		// NOTE: The game thread only queues the scene renders, their cost is read back once the render thread has run them.
+		TSharedRef<FPortalCaptureTimer, ESPMode::ThreadSafe> timer = MakeShared<FPortalCaptureTimer, ESPMode::ThreadSafe>();
+		timer->portal = portal;
+		captureTimers.Add(timer);
+		ENQUEUE_RENDER_COMMAND(PortalCaptureStart)([timer](FRHICommandListImmediate& RHICmdList)
+		{
+			timer->startCycles = FPlatformTime::Cycles64();
+		});
+		portal->ExecuteScheduledCapture();
+		ENQUEUE_RENDER_COMMAND(PortalCaptureEnd)([timer](FRHICommandListImmediate& RHICmdList)
+		{
+			timer->milliseconds = (float)FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - timer->startCycles);
+			timer->finished = true;
+		});
+
+		captureStats.usedMs += estimatedCost;
+		captureStats.issued++;
+	}
+	urgentCaptureRequests.Reset();
+	captureStats.totalDeferred += captureStats.deferred;
+}
+
+FPortalCaptureStats APortalManager::GetCaptureStats() const
+{
+	return captureStats;
+}
+
+void FPortalManagerPhysicsTick::ExecuteTick(float DeltaTime, enum ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	// Call the portal managers second tick function for running post tick.
+	if (Target) Target->PostPhysicsTick(DeltaTime);
+}
@@ -0,0 +1,718 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "HelperMacros.h"
+#include "PortalTracking.h"
+#include "PortalManager.generated.h"
+
+/* Logging category for this class. */
+DECLARE_LOG_CATEGORY_EXTERN(LogPortalManager, Log, All);
+
+/* Post physics tick for the portal manager to update every portals pawn and tracked actor teleporting in one pass.
+ * NOTE: After physics as the pawns and tracked actors are physics driven. */
+USTRUCT()
+struct FPortalManagerPhysicsTick : public FActorTickFunction
+{
+	GENERATED_BODY()
+
+	/* Target actor. */
+	class APortalManager* Target;
+
+	/* Declaration of the new ticking function for this class. */
+	virtual void ExecuteTick(float DeltaTime, enum ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+};
+
+template <>
+struct TStructOpsTypeTraits<FPortalManagerPhysicsTick> : public TStructOpsTypeTraitsBase2<FPortalManagerPhysicsTick>
+{
+	enum { WithCopy = false };
+};
+
+/* Primitives bucketed into grid cells by their bounds so portals only check the primitives near their target portal.
+ * NOTE: Primitives covering more than maxCellsPerPrimitive cells, like the levels BSP or a landscape, are returned by every query instead.
+ *       Removed primitives leave a free index that the next added primitive reuses. */
+struct FPortalPrimitiveGrid
+{
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> primitives; /* Every primitive in the grid, null at free indices. */
+	TArray<FBox> primitiveBounds; /* World bounds of each primitive when added or last updated. */
+	TArray<FIntVector> primitiveMinCells; /* The lowest cell each primitive is in. */
+	TArray<FIntVector> primitiveMaxCells; /* The highest cell each primitive is in. */
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, int32> primitiveIndices; /* Index of each primitive in the grid. */
+	TArray<int32> freeIndices; /* Indices of removed primitives. */
+	TMap<FIntVector, TArray<int32>> cells; /* Each occupied cell to the primitives overlapping it. */
+	TArray<int32> largePrimitives; /* Primitives covering too many cells to add to each one. */
+	float cellSize; /* Size of each cell. */
+	static const int32 maxCellsPerPrimitive = 64;
+
+	/* Default Constructor. */
+	FPortalPrimitiveGrid()
+	{
+		cellSize = 2000.0f;
+	}
+
+	/* Empty the grid and set the cell size for the primitives added next. */
+	void Reset(float newCellSize);
+
+	/* Add a registered primitive at its current bounds if it isn't in the grid already. */
+	void Add(UPrimitiveComponent* primitive);
+
+	/* Take the primitive at the index out of the grid. */
+	void Remove(int32 index);
+
+	/* Refresh the bounds of every movable primitive and only move those whose bounds left their cells, removing destroyed or unregistered ones.
+	 * NOTE: Only compares bounds for primitives that haven't moved cells so it doesn't rebuild the grid. */
+	void UpdateMoved();
+
+	/* Add each primitive whose bounds overlap the box to the output once. */
+	void Query(const FBox& box, TArray<UPrimitiveComponent*>& outPrimitives) const;
+
+	/* Is the primitive in the grid. */
+	FORCEINLINE bool Contains(UPrimitiveComponent* primitive) const { return primitiveIndices.Contains(primitive); }
+
+	/* Number of primitives in the grid. */
+	FORCEINLINE int32 Num() const { return primitives.Num() - freeIndices.Num(); }
+
+private:
+
+	/* Get the cells the bounds overlap. */
+	void GetCells(const FBox& bounds, FIntVector& outMinCell, FIntVector& outMaxCell) const;
+
+	/* Add the primitive at the index to the cells it was last found in. */
+	void AddToCells(int32 index);
+
+	/* Take the primitive at the index out of the cells it was last found in. */
+	void RemoveFromCells(int32 index);
+};
+
+/* A render target owned by the pool and how it is being used. */
+USTRUCT()
+struct FPooledRenderTarget
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY()
+	class UCanvasRenderTarget2D* renderTarget;
+
+	float lastUsedTime;
+	bool inUse;
+
+public:
+
+	/* Default Constructor. */
+	FPooledRenderTarget()
+	{
+		renderTarget = nullptr;
+		lastUsedTime = 0.0f;
+		inUse = false;
+	}
+};
+
+/* Pool of render targets lent to portals while they are active. Render targets are bucketed by size so they can be reused
+ * by any portal wanting a similar size, meaning memory scales with the number of visible portals and not placed portals. */
+USTRUCT()
+struct FPortalRenderTargetPool
+{
+	GENERATED_BODY()
+
+public:
+
+	/* All render targets created by the pool. */
+	UPROPERTY()
+	TArray<FPooledRenderTarget> renderTargets;
+
+public:
+
+	/* Returns the size of the bucket the given size will be allocated from. */
+	static FIntPoint GetBucketSize(FIntPoint size);
+
+	/* Lend a render target of at least the given size, creating one if none are free. */
+	class UCanvasRenderTarget2D* Acquire(UObject* worldContext, FIntPoint size, float currentTime);
+
+	/* Return a render target to the pool so other portals can use it. */
+	void Release(class UCanvasRenderTarget2D* renderTarget, float currentTime);
+
+	/* Free any render targets that haven't been used for the given time. */
+	void Trim(float currentTime, float maxUnusedTime);
+
+	/* Number of render targets currently lent out. */
+	int GetNumInUse() const;
+};
+
+/* A duplicate actor owned by the pool and how it is being used. */
+USTRUCT()
+struct FPooledDuplicate
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY()
+	AActor* duplicate;
+
+	/* The root static mesh the duplicate was made with, nullptr if its root isn't a static mesh. */
+	UPROPERTY()
+	class UStaticMesh* mesh;
+
+	float lastUsedTime;
+	bool inUse;
+
+public:
+
+	/* Default Constructor. */
+	FPooledDuplicate()
+	{
+		duplicate = nullptr;
+		mesh = nullptr;
+		lastUsedTime = 0.0f;
+		inUse = false;
+	}
+};
+
+/* Recent use of the duplicates made from one class and root static mesh, kept to warm up the pool before they're needed. */
+USTRUCT()
+struct FPooledDuplicateUsage
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY()
+	UClass* actorClass;
+
+	UPROPERTY()
+	class UStaticMesh* mesh;
+
+	TWeakObjectPtr<AActor> source; /* The last actor duplicated with this class and mesh, used as the template when warming up. */
+	int highWater; /* Most duplicates in use at once recently. */
+	float highWaterTime; /* Time the high water mark was last reached. */
+
+public:
+
+	/* Default Constructor. */
+	FPooledDuplicateUsage()
+	{
+		actorClass = nullptr;
+		mesh = nullptr;
+		highWater = 0;
+		highWaterTime = 0.0f;
+	}
+};
+
+/* Pool of the duplicate actors portals show at their target portal for tracked actors. Duplicates are matched by class and root
+ * static mesh so they can be reused by any portal tracking a similar actor, meaning actors crossing portals don't create or destroy
+ * actors once the pool has warmed up. NOTE: Free duplicates are hidden with collision disabled. */
+USTRUCT()
+struct FPortalDuplicatePool
+{
+	GENERATED_BODY()
+
+public:
+
+	/* All duplicates created by the pool. */
+	UPROPERTY()
+	TArray<FPooledDuplicate> duplicates;
+
+	/* Recent use of each class and mesh duplicated. */
+	UPROPERTY()
+	TArray<FPooledDuplicateUsage> usage;
+
+public:
+
+	/* Lend a duplicate of the given actor, creating one if none are free. */
+	AActor* Acquire(UObject* outer, AActor* source, float currentTime);
+
+	/* Return a duplicate to the pool so other portals can use it. */
+	void Release(AActor* duplicate, float currentTime);
+
+	/* Destroy any duplicates that haven't been used for the given time and aren't needed to keep the pool warm, then create a free
+	 * spare over the high water mark of each class and mesh used recently. NOTE: Lowers the high water marks not reached for the
+	 * given time by one. Created duplicates are added to outCreated. */
+	void Trim(UWorld* world, UObject* outer, float currentTime, float maxUnusedTime, TArray<AActor*>& outCreated);
+
+	/* Number of duplicates currently lent out. */
+	int GetNumInUse() const;
+
+private:
+
+	/* Create a duplicate of the given actor, hidden with collision disabled unless in use. */
+	AActor* Create(UObject* outer, AActor* source, class UStaticMesh* sourceMesh, float currentTime, bool inUse);
+
+	/* Number of valid duplicates made from the class and mesh, optionally only those lent out. */
+	int CountDuplicates(UClass* actorClass, class UStaticMesh* mesh, bool onlyInUse) const;
+
+	/* Number of duplicates to keep for the class and mesh, one more than its high water mark if used recently. */
+	int GetWarmCount(UClass* actorClass, class UStaticMesh* mesh) const;
+};
+
+/* Stats from the portal managers capture scheduling for the last frame. */
+USTRUCT(BlueprintType)
+struct FPortalCaptureStats
+{
+	GENERATED_BODY()
+
+public:
+
+	/* Number of portals requesting a capture. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	int requested;
+
+	/* Number of captures issued. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	int issued;
+
+	/* Number of captures carried over to the next frame. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	int deferred;
+
+	/* Total number of captures carried over since the level started. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	int totalDeferred;
+
+	/* Longest time in seconds a deferred portal has been waiting since its last update. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	float oldestDeferredTime;
+
+	/* Estimated render thread milliseconds of the issued captures. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	float usedMs;
+
+	/* Render thread milliseconds available after adapting to the GPU frame time. */
+	UPROPERTY(BlueprintReadOnly, Category = "Portal")
+	float budgetMs;
+
+public:
+
+	/* Default Constructor. */
+	FPortalCaptureStats()
+	{
+		requested = 0;
+		issued = 0;
+		deferred = 0;
+		totalDeferred = 0;
+		oldestDeferredTime = 0.0f;
+		usedMs = 0.0f;
+		budgetMs = 0.0f;
+	}
+};
+
+/* Render thread time taken by a scheduled capture, written by the render thread and read back by the portal manager on a later frame.
+ * NOTE: Timed between render commands queued before and after the capture so it covers every scene render the capture queued. */
+struct FPortalCaptureTimer
+{
+	TWeakObjectPtr<class APortal> portal; /* The portal that was captured. Only used on the game thread. */
+	uint64 startCycles; /* Render thread cycles when the capture started. Only used on the render thread. */
+	float milliseconds; /* Render thread milliseconds the capture took, valid once finished. */
+	FThreadSafeBool finished; /* Has the render thread run the capture. */
+
+	/* Default Constructor. */
+	FPortalCaptureTimer()
+	{
+		startCycles = 0;
+		milliseconds = 0.0f;
+	}
+};
+
+/* A local player viewing the portals. Each viewer gets its own portal captures, everything else is shared between them. */
+USTRUCT()
+struct FPortalViewer
+{
+	GENERATED_BODY()
+
+public:
+
+	/* The viewers player controller. */
+	UPROPERTY()
+	class APlayerController* controller;
+
+	/* The viewers local player used for its projection. */
+	UPROPERTY()
+	class UPortalPlayer* player;
+
+	/* The viewers portal pawn. */
+	UPROPERTY()
+	class APortalPawn* pawn;
+
+	/* Portals near the viewers camera it is in-front of, found when activation was last checked. */
+	UPROPERTY()
+	TArray<class APortal*> nearbyPortals;
+
+	TMap<class APortal*, int> rootViewNodes; /* Node index of each portal visible from the viewers camera this frame. */
+	FIntVector lastActivationCell; /* Grid cell the camera was in when activation was last checked. */
+	FVector lastActivationLoc; /* Camera location when activation was last checked. */
+	FVector lastActivationDir; /* Camera direction when activation was last checked. */
+
+public:
+
+	/* Default Constructor. */
+	FPortalViewer()
+	{
+		controller = nullptr;
+		player = nullptr;
+		pawn = nullptr;
+		lastActivationCell = FIntVector::ZeroValue;
+		lastActivationLoc = FVector::ZeroVector;
+		lastActivationDir = FVector::ZeroVector;
+	}
+};
+
+/* A portal seen from a viewers camera or through other portals, found each frame by the portal managers visibility traversal. */
+struct FPortalViewNode
+{
+	class APortal* portal; /* The visible portal. */
+	int viewer; /* Index of the viewer the portal is seen by. */
+	int parent; /* Index of the node this portal is seen through, INDEX_NONE if seen from the player camera. */
+	int depth; /* Number of portals this portal is seen through. */
+	FTransform viewTransform; /* Transform from the player camera to the camera this portal is seen from. */
+	FBox2D screenBounds; /* Bounds of the portal on screen clipped by the portals it is seen through. */
+	TArray<int, TInlineAllocator<4>> children; /* Indices of the nodes seen through this portal. */
+};
+
+/* World level manager for resources and work shared between every portal in the level.
+ * NOTE: Spawned automatically by the first portal that needs it, use APortalManager::Get. */
+UCLASS(NotPlaceable, Transient)
+class BETTERPORTALS_API APortalManager : public AActor
+{
+	GENERATED_BODY()
+
+	/* Make post physics friend so it can access the tick function. */
+	friend FPortalManagerPhysicsTick;
+
+public:
+
+	/* Time in seconds a free render target is kept in the pool before being released. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	float renderTargetKeepTime;
+
+	/* Time in seconds a free duplicate is kept in the pool before being destroyed, so duplicates stay warm while actors keep crossing.
+	 * NOTE: Also how long each class and meshes high water mark is held before being lowered, one spare over it is always kept. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal")
+	float duplicateKeepTime;
+
+	/* Max portals setup each frame so a level full of portals doesn't setup in one frame. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal", meta = (ClampMin = "1"))
+	int maxSetupsPerFrame;
+
+	/* Size of the grid cells portals are stored in for finding the portals near the camera. NOTE: Set before any portals register. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Activation", meta = (ClampMin = "1.0"))
+	float portalGridCellSize;
+
+	/* Activate portals near the camera and deactivate the rest, otherwise portals are left active. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Activation")
+	bool manageActivation;
+
+	/* Max distance from the camera a portal can be activated at. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Activation", meta = (ClampMin = "0.0"))
+	float activationDistance;
+
+	/* Only activate portals the camera is facing towards. Also re-checks activation when the camera turns. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Activation")
+	bool activationCheckDirection;
+
+	/* How far the camera can move within a grid cell before portal activation is checked again. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Activation", meta = (ClampMin = "0.0"))
+	float activationMoveThreshold;
+
+	/* Issue portal captures at the end of the frame in order of priority until the capture budget is used, carrying the rest over. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Scheduling")
+	bool scheduleCaptures;
+
+	/* Render thread milliseconds portal captures can use each frame, estimated from each portals measured capture cost.
+	 * NOTE: Measures the render thread queuing each captures scene renders, not GPU time. The GPU is only considered through targetGPUFrameMs. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Scheduling", meta = (ClampMin = "0.0"))
+	float renderThreadBudgetMs;
+
+	/* The capture budget shrinks while the GPU frame time is over this and grows back while under. NOTE: Zero disables. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Scheduling", meta = (ClampMin = "0.0"))
+	float targetGPUFrameMs;
+
+	/* Captures always issued each frame even if over budget so the most important portal is never stale. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Scheduling", meta = (ClampMin = "0"))
+	int minCapturesPerFrame;
+
+	/* Find the portals visible from the camera and through other portals each frame. Portals seen through another portal are
+	 * captured from its view so chains of different portals render correctly. NOTE: Portals behind the camera or off screen are
+	 * not traversed, activation still uses the portals near the camera. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Visibility")
+	bool visibilityTraversal;
+
+	/* The most portals deep the visibility traversal will look through. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Visibility", meta = (ClampMin = "0"))
+	int maxVisibilityDepth;
+
+	/* The most visible portals found each frame including the portals visible from the camera. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Visibility", meta = (ClampMin = "1"))
+	int maxVisibilityNodes;
+
+	/* How far from a target portal to look for portals seen through it. */
+	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Portal|Visibility", meta = (ClampMin = "0.0"))
+	float traversalDistance;
+
+protected:
+
+	/* Render targets shared between the portals. */
+	UPROPERTY()
+	FPortalRenderTargetPool renderTargetPool;
+
+	/* Duplicates of tracked actors shared between the portals. */
+	UPROPERTY()
+	FPortalDuplicatePool duplicatePool;
+
+	/* Post ticking declaration. */
+	FPortalManagerPhysicsTick physicsTick;
+
+	/* Ranges of the active portals tracked actors this frame and the update gathered for each. NOTE: Kept to reuse their memory. */
+	TArray<FTrackedActorsChunk> trackedChunks;
+	TArray<FTrackedActorsUpdate> trackedUpdates;
+
+	/* Every portals volumes, the physics bodies tested against them and what each portal overlaps this frame. NOTE: Kept to reuse their memory. */
+	TArray<FPortalBroadphaseProxy> portalProxies;
+	TMap<class APortal*, int32> portalProxyIndices;
+	bool portalProxiesDirty; /* Have portals been registered or unregistered since the proxies were built. */
+	TArray<FBroadphaseBody> broadphaseBodies;
+	TArray<FPortalOverlaps> portalOverlaps;
+
+	/* Portals waiting to be setup, in the order they began play. */
+	UPROPERTY()
+	TArray<class APortal*> pendingSetups;
+
+	/* The next portal update phase to give out. */
+	int nextUpdatePhase;
+
+	/* Actors with movable primitives or spawned after the level started that portals need to re-check each update. */
+	TArray<TWeakObjectPtr<AActor>> dynamicActors;
+
+	/* Increased each time a level is streamed in or out so portals know to rebuild anything built from the levels actors. */
+	int sceneVersion;
+
+	/* The primitives of every actor that isn't dynamic and the levels BSP, rebuilt when the scene version changes. */
+	FPortalPrimitiveGrid staticPrimitives;
+	int staticPrimitivesVersion;
+
+	/* The primitives of the dynamic actors, updated at most once a frame by moving only the primitives that left their cells. */
+	FPortalPrimitiveGrid dynamicPrimitives;
+	uint64 dynamicPrimitivesFrame;
+
+	/* Dynamic actors whose primitives need adding to the dynamic primitives, also re-added periodically to find components added at runtime. */
+	TArray<TWeakObjectPtr<AActor>> pendingDynamicActors;
+
+	/* Every registered portal. */
+	UPROPERTY()
+	TArray<class APortal*> portals;
+
+	/* Every registered portal that is active. NOTE: Kept up to date by the portals as they are activated and deactivated. */
+	UPROPERTY()
+	TArray<class APortal*> activePortals;
+
+	/* Grid of cells to the portals with bounds overlapping them. */
+	TMap<FIntVector, TArray<class APortal*>> portalGrid;
+
+	/* The bounds each portal was registered with. */
+	TMap<class APortal*, FBox> portalBounds;
+
+	/* Local players viewing the portals, updated each frame. */
+	UPROPERTY()
+	TArray<FPortalViewer> viewers;
+
+	/* Meshes each viewer sees the portals through, indexed by viewer. Viewers are shown their own meshes and not the others.
+	 * NOTE: The first viewer uses each portals own mesh which is also the only one seen by portal captures. */
+	TArray<TArray<TWeakObjectPtr<class UPrimitiveComponent>>> viewerMeshes;
+
+	/* Every mesh added for viewers after the first, hidden from portal captures. */
+	TArray<TWeakObjectPtr<class UPrimitiveComponent>> captureHiddenMeshes;
+
+	/* Visible portals found this frame in breadth first order. */
+	TArray<FPortalViewNode> viewNodes;
+
+	/* Portals requesting a capture this frame. */
+	UPROPERTY()
+	TArray<class APortal*> captureRequests;
+
+	/* Portals whose requested capture must be issued this frame whatever the budget. */
+	UPROPERTY()
+	TArray<class APortal*> urgentCaptureRequests;
+
+	/* Timers of the issued captures the render thread hasn't finished or the manager hasn't read back yet. */
+	TArray<TSharedRef<FPortalCaptureTimer, ESPMode::ThreadSafe>> captureTimers;
+
+	/* Stats from the last frames capture scheduling. */
+	UPROPERTY()
+	FPortalCaptureStats captureStats;
+
+	float budgetScale; /* Scale applied to the capture budget from the GPU frame time. */
+	float measuredCaptureCost; /* Running mean of the measured capture costs of every portal, zero until the first is read back. */
+	FDelegateHandle postActorTickHandle; /* Handle for the worlds post actor tick delegate. */
+
+	bool viewerMeshesDirty; /* Have the viewers or their meshes changed since each viewers hidden meshes were updated. */
+	bool activationDirty; /* Should activation be checked on the next tick. */
+	float lastTrimTime; /* World time unused resources were last trimmed. */
+
+private:
+
+	FDelegateHandle actorSpawnedHandle; /* Handle for the worlds actor spawned delegate. */
+	FDelegateHandle levelAddedHandle; /* Handle for the level added to world delegate. */
+	FDelegateHandle levelRemovedHandle; /* Handle for the level removed from world delegate. */
+
+	/* Called when a level is streamed in or out of any world. */
+	void OnLevelChanged(class ULevel* level, UWorld* world);
+
+	/* Called after every actor in a world has ticked. */
+	void OnWorldPostActorTick(UWorld* world, ELevelTick tickType, float deltaTime);
+
+	/* Post physics ticking function. Teleports pawns and tracked actors through every active portal.
+	 * NOTE: The tracked actors of every portal are gathered in parallel then moved and teleported on the game thread. */
+	void PostPhysicsTick(float DeltaTime);
+
+	/* Test every physics simulating dynamic actor against the portals near it in one pass and give each portal the actors entering and leaving it.
+	 * NOTE: Bodies are tested in parallel against the portals in the grid cells their swept bounds overlap, only bodies that overlap the portal
+	 *       box collision channel are tested. */
+	void UpdateBroadphase(float DeltaTime);
+
+	/* Find the index of every portal proxy in the grid cells overlapping the box, or every proxy if that would be fewer. Sorted by index. */
+	void FindPortalProxies(const FBox& box, TArray<int32, TInlineAllocator<8>>& outProxies) const;
+
+	/* Add a portal to every grid cell the bounds overlap. */
+	void AddToPortalGrid(class APortal* portal, const FBox& bounds);
+
+	/* Remove a portal from every grid cell the bounds overlap. */
+	void RemoveFromPortalGrid(class APortal* portal, const FBox& bounds);
+
+	/* Setup the queued portals that are ready, up to the max setups per frame. */
+	void UpdatePendingSetups();
+
+	/* Find the local players with a portal pawn. */
+	void UpdateViewers();
+
+	/* Hide the meshes of every other viewer from each viewers player controller and rebuild the meshes hidden from captures. */
+	void UpdateViewerMeshes();
+
+	/* Activate the given portals and deactivate the active portals that aren't in the list. */
+	void SetActivePortals(TArray<class APortal*>& newActivePortals);
+
+	/* Add a view node for a portal if its visible from the given view within the parents screen bounds. Returns the new nodes index or INDEX_NONE. */
+	int AddViewNode(class APortal* portal, int viewer, int parent, const FTransform& viewTransform, const FVector& cameraLocation, const FQuat& cameraRotation,
+		const FMatrix& projection, FIntPoint viewSize);
+
+protected:
+
+	/* Level start. */
+	virtual void BeginPlay() override;
+
+	/* Level end. */
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+
+	/* Constructor. */
+	APortalManager();
+
+	/* Frame. */
+	virtual void Tick(float DeltaTime) override;
+
+	/* Returns the portal manager for the given world, spawning one if there isn't one yet. */
+	static APortalManager* Get(UWorld* world);
+
+	/* Lend a render target of at least the given size to a portal. */
+	class UCanvasRenderTarget2D* AcquireRenderTarget(FIntPoint size);
+
+	/* Return a render target lent to a portal. */
+	void ReleaseRenderTarget(class UCanvasRenderTarget2D* renderTarget);
+
+	/* Lend a duplicate of an actor for a portal to show at its target portal. */
+	AActor* AcquireDuplicate(AActor* source);
+
+	/* Return a duplicate lent to a portal. */
+	void ReleaseDuplicate(AActor* duplicate);
+
+	/* Returns a new phase for a portal to offset its updates by so portals on the same update rate are spread across frames. */
+	int GetNextUpdatePhase();
+
+	/* Add an actor to the dynamic actors so portals re-check it each update.
+	 * NOTE: Actors spawned with SpawnActor are added automatically, actors created another way need adding manually. */
+	void RegisterDynamicActor(AActor* actor);
+
+	/* Returns the actors that can move or were spawned after the level started. NOTE: May contain stale entries. */
+	FORCEINLINE const TArray<TWeakObjectPtr<AActor>>& GetDynamicActors() const { return dynamicActors; }
+
+	/* Returns the current scene version, changes when levels are streamed in or out. */
+	FORCEINLINE int GetSceneVersion() const { return sceneVersion; }
+
+	/* Returns the grid of primitives that don't move, found once for every portal each time the scene version changes. */
+	const FPortalPrimitiveGrid& GetStaticPrimitives();
+
+	/* Returns the grid of the dynamic actors primitives at their bounds this frame, updated once for every portal each frame. */
+	const FPortalPrimitiveGrid& GetDynamicPrimitives();
+
+	/* Does the given actor have any movable primitive components. */
+	static bool HasMovablePrimitives(AActor* actor);
+
+	/* Queue a portal to be setup once it is ready. NOTE: Portals are setup at the start of the managers tick. */
+	void RequestSetup(class APortal* portal);
+
+	/* Remove a portal from the setup queue. */
+	void CancelSetup(class APortal* portal);
+
+	/* Add a portal to the portal grid. NOTE: Portals that move are moved in the grid by the next broadphase. */
+	void RegisterPortal(class APortal* portal);
+
+	/* Remove a portal from the portal grid. */
+	void UnregisterPortal(class APortal* portal);
+
+	/* Add or remove a registered portal from the active portals when it is activated or deactivated. */
+	void OnPortalActiveChanged(class APortal* portal);
+
+	/* Find the registered portals with bounds within the given radius of a location. */
+	void GetPortalsInRadius(const FVector& location, float radius, TArray<class APortal*>& outPortals) const;
+
+	/* Returns the grid cell containing the given location. */
+	FIntVector GetGridCell(const FVector& location) const;
+
+	/* Check portal activation on the next tick even if the camera hasn't moved. */
+	void RequestActivationUpdate();
+
+	/* Returns the number of local players viewing the portals. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	int GetNumViewers() const;
+
+	/* Returns a local player viewing the portals. */
+	FORCEINLINE const FPortalViewer& GetViewer(int viewer) const { return viewers[viewer]; }
+
+	/* Add a mesh only the given viewer should see a portal through. */
+	void RegisterViewerMesh(int viewer, class UPrimitiveComponent* mesh);
+
+	/* Remove a mesh added with RegisterViewerMesh. */
+	void UnregisterViewerMesh(int viewer, class UPrimitiveComponent* mesh);
+
+	/* Returns the meshes added for viewers after the first, these should be hidden from portal captures. */
+	FORCEINLINE const TArray<TWeakObjectPtr<class UPrimitiveComponent>>& GetCaptureHiddenMeshes() const { return captureHiddenMeshes; }
+
+	/* Find the portals near a viewers camera that could be visible. Activates them unless activation uses the visibility traversal. */
+	void UpdateActivation(int viewer, const FVector& cameraLocation, const FVector& cameraDirection);
+
+	/* Traverse from each viewers camera through each visible portal into the portals visible through it up to the depth and node budget.
+	 * NOTE: The node budget is shared between the viewers and portals found through the same target portal are only searched for once. */
+	void UpdateVisibility();
+
+	/* Returns the node index of the given portal seen from a viewers camera this frame, INDEX_NONE if it isn't visible. */
+	int FindRootViewNode(int viewer, class APortal* portal) const;
+
+	/* Returns a view node found this frame. */
+	FORCEINLINE const FPortalViewNode& GetViewNode(int nodeIndex) const { return viewNodes[nodeIndex]; }
+
+	/* Request a capture for a portal this frame. Issued after every portal has updated if it fits in the capture budget.
+	 * NOTE: Urgent requests go first and are always issued, used when a viewer has just teleported to the portal. */
+	void RequestCapture(class APortal* portal, bool urgent = false);
+
+	/* Issue the requested captures with the highest priority until the capture budget is used. */
+	void IssueCaptures();
+
+	/* Returns the stats from the last frames capture scheduling. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	FPortalCaptureStats GetCaptureStats() const;
+
+	/* Number of visible portals found this frame including through other portals. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	int GetNumViewNodes() const;
+};
@@ -0,0 +1,250 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "PortalMath.h"
+#include "Math/QuatRotationTranslationMatrix.h"
+#include "Math/TranslationMatrix.h"
+
+FPlane FPortalMath::WorldPlaneToView(const FPlane& worldPlane, const FVector& viewLocation, const FQuat& viewRotation)
+{
+	// Get the cameras axis in world space.
+	FVector forward = viewRotation.GetForwardVector();
+	FVector right = viewRotation.GetRightVector();
+	FVector up = viewRotation.GetUpVector();
+
+	// Project the planes normal onto the view axis and move its distance relative to the camera location.
+	FVector worldNormal = FVector(worldPlane);
+	FVector viewNormal = FVector(FVector::DotProduct(worldNormal, right), FVector::DotProduct(worldNormal, up), FVector::DotProduct(worldNormal, forward));
+	return FPlane(viewNormal, worldPlane.W - FVector::DotProduct(worldNormal, viewLocation));
+}
+
+FMatrix FPortalMath::MakeObliqueProjectionMatrix(const FMatrix& projection, const FPlane& viewClipPlane)
+{
+	// Clip plane as a 4D vector so that clipPlane dot (x, y, z, 1) >= 0 is visible.
+	FVector4 clipPlane = FVector4(viewClipPlane.X, viewClipPlane.Y, viewClipPlane.Z, -viewClipPlane.W);
+
+	// The camera must be behind the clip plane otherwise the near plane would face the wrong way.
+	if (clipPlane.W >= 0.0f) return projection;
+
+	// Find the direction to the frustum corner furthest along the clip plane.
+	// NOTE: Handles off-axis projections so it will also work on cropped projection matrices.
+	FVector4 corner;
+	corner.X = (FMath::Sign(clipPlane.X) - projection.M[2][0]) / projection.M[0][0];
+	corner.Y = (FMath::Sign(clipPlane.Y) - projection.M[2][1]) / projection.M[1][1];
+	corner.Z = 1.0f;
+	corner.W = 0.0f;
+
+	// Scale the plane so the new far plane still contains the original frustum.
+	float planeDotCorner = clipPlane.X * corner.X + clipPlane.Y * corner.Y + clipPlane.Z * corner.Z;
+	if (planeDotCorner <= KINDA_SMALL_NUMBER) return projection;
+	float scale = 1.0f / planeDotCorner;
+
+	// Replace the depth column so the reversed Z near plane (depth == w) lies on the clip plane.
+	FMatrix obliqueProjection = projection;
+	obliqueProjection.M[0][2] = projection.M[0][3] - scale * clipPlane.X;
+	obliqueProjection.M[1][2] = projection.M[1][3] - scale * clipPlane.Y;
+	obliqueProjection.M[2][2] = projection.M[2][3] - scale * clipPlane.Z;
+	obliqueProjection.M[3][2] = projection.M[3][3] - scale * clipPlane.W;
+	return obliqueProjection;
+}
+
+FMatrix FPortalMath::MakeViewProjectionMatrix(const FVector& viewLocation, const FQuat& viewRotation, const FMatrix& projection)
+{
+	// Swap the axis from the engines X forward to the projection matrices Z forward.
+	FMatrix viewRotationMatrix = FQuatRotationMatrix(viewRotation.Inverse()) * FMatrix(
+		FPlane(0.0f, 0.0f, 1.0f, 0.0f),
+		FPlane(1.0f, 0.0f, 0.0f, 0.0f),
+		FPlane(0.0f, 1.0f, 0.0f, 0.0f),
+		FPlane(0.0f, 0.0f, 0.0f, 1.0f));
+	return FTranslationMatrix(-viewLocation) * viewRotationMatrix * projection;
+}
+
+bool FPortalMath::GetScreenBounds(const FMatrix& viewProjection, const FVector* points, int32 numPoints, FBox2D& outBounds)
+{
+	// Track which side of the frustum every point is outside of, if they all share a side nothing is visible.
+	outBounds = FBox2D(ForceInit);
+	uint32 sharedOutside = 0xF;
+	int32 numBehind = 0;
+	for (int32 i = 0; i < numPoints; i++)
+	{
+		FVector4 clipPoint = viewProjection.TransformFVector4(FVector4(points[i], 1.0f));
+
+		// Points behind the camera cannot be projected so count them and decide once every point is checked.
+		if (clipPoint.W <= KINDA_SMALL_NUMBER)
+		{
+			numBehind++;
+			continue;
+		}
+
+		// Add the point in screen UV space. NOTE: Screen UV Y is flipped from clip space.
+		FVector2D ndc = FVector2D(clipPoint.X / clipPoint.W, clipPoint.Y / clipPoint.W);
+		outBounds += FVector2D(ndc.X * 0.5f + 0.5f, 0.5f - ndc.Y * 0.5f);
+		uint32 outside = (ndc.X < -1.0f ? 1 : 0) | (ndc.X > 1.0f ? 2 : 0) | (ndc.Y < -1.0f ? 4 : 0) | (ndc.Y > 1.0f ? 8 : 0);
+		sharedOutside &= outside;
+	}
+	if (numBehind == numPoints) return false;
+
+	// Some points are in front and some behind so the projection would wrap, fall back to the full screen.
+	if (numBehind > 0)
+	{
+		outBounds = FBox2D(FVector2D(0.0f, 0.0f), FVector2D(1.0f, 1.0f));
+		return true;
+	}
+	if (sharedOutside != 0) return false;
+
+	// Clamp to the screen.
+	outBounds.Min = FVector2D(FMath::Clamp(outBounds.Min.X, 0.0f, 1.0f), FMath::Clamp(outBounds.Min.Y, 0.0f, 1.0f));
+	outBounds.Max = FVector2D(FMath::Clamp(outBounds.Max.X, 0.0f, 1.0f), FMath::Clamp(outBounds.Max.Y, 0.0f, 1.0f));
+	return outBounds.Max.X > outBounds.Min.X && outBounds.Max.Y > outBounds.Min.Y;
+}
+
+FMatrix FPortalMath::CropProjectionMatrix(const FMatrix& projection, const FBox2D& screenBounds)
+{
+	// Get the center and half size of the bounds in clip space.
+	FVector2D size = screenBounds.GetSize();
+	if (size.X <= KINDA_SMALL_NUMBER || size.Y <= KINDA_SMALL_NUMBER) return projection;
+	FVector2D halfSize = size; // NOTE: Half of the clip space size is the same as the UV size.
+	FVector2D center = FVector2D(screenBounds.Min.X + screenBounds.Max.X - 1.0f, 1.0f - (screenBounds.Min.Y + screenBounds.Max.Y));
+
+	// Scale and offset the X and Y columns so the bounds map to the whole clip space.
+	FMatrix croppedProjection = projection;
+	for (int32 row = 0; row < 4; row++)
+	{
+		croppedProjection.M[row][0] = (projection.M[row][0] - center.X * projection.M[row][3]) / halfSize.X;
+		croppedProjection.M[row][1] = (projection.M[row][1] - center.Y * projection.M[row][3]) / halfSize.Y;
+	}
+	return croppedProjection;
+}
+
+FLinearColor FPortalMath::GetScreenUVScaleBias(const FBox2D& screenBounds)
+{
+	FVector2D size = screenBounds.GetSize();
+	if (size.X <= KINDA_SMALL_NUMBER || size.Y <= KINDA_SMALL_NUMBER) return FLinearColor(1.0f, 1.0f, 0.0f, 0.0f);
+	return FLinearColor(1.0f / size.X, 1.0f / size.Y, -screenBounds.Min.X / size.X, -screenBounds.Min.Y / size.Y);
+}
+
+FMatrix FPortalMath::MakeReprojectionMatrix(const FVector& previousLocation, const FQuat& previousRotation, const FMatrix& currentViewProjection)
+{
+	// Swap the axis from the projection matrices Z forward back to the engines X forward then to world space from the previous view.
+	FMatrix previousViewToWorld = FMatrix(
+		FPlane(0.0f, 1.0f, 0.0f, 0.0f),
+		FPlane(0.0f, 0.0f, 1.0f, 0.0f),
+		FPlane(1.0f, 0.0f, 0.0f, 0.0f),
+		FPlane(0.0f, 0.0f, 0.0f, 1.0f)) * FQuatRotationMatrix(previousRotation) * FTranslationMatrix(previousLocation);
+	return previousViewToWorld * currentViewProjection;
+}
+
+FLinearColor FPortalMath::GetUnprojectParameters(const FMatrix& projection)
+{
+	return FLinearColor(1.0f / projection.M[0][0], 1.0f / projection.M[1][1], projection.M[2][0], projection.M[2][1]);
+}
+
+FLinearColor FPortalMath::GetDepthParameters(const FMatrix& captureProjection)
+{
+	float depthAdd = captureProjection.M[3][2];
+	if (FMath::Abs(depthAdd) <= SMALL_NUMBER) return FLinearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	return FLinearColor(captureProjection.M[0][2] / depthAdd, captureProjection.M[1][2] / depthAdd, 0.0f, 0.0f);
+}
+
+float FPortalMath::GetViewDepth(float sceneDepth, const FVector2D& clipPosition, const FLinearColor& unproject, const FLinearColor& depthParameters)
+{
+	// The stored depth is W * depth / (X * viewX + Y * viewY + W) for the depth columns terms, solve it for depth using viewXY = unprojectedXY * depth.
+	FVector2D unprojected = (clipPosition - FVector2D(unproject.B, unproject.A)) * FVector2D(unproject.R, unproject.G);
+	float denominator = 1.0f - sceneDepth * (depthParameters.R * unprojected.X + depthParameters.G * unprojected.Y);
+	return sceneDepth / FMath::Max(denominator, 0.0001f);
+}
+
+bool FPortalMath::SweepThroughAperture(const FTransform& aperture, const FVector2D& apertureExtent, const FVector& start, const FVector& end,
+	const FVector& boxExtent, float& outTime)
+{
+	// Only crossing from the front to the back of the aperture counts.
+	FVector localStart = aperture.InverseTransformPositionNoScale(start);
+	FVector localEnd = aperture.InverseTransformPositionNoScale(end);
+	if (localStart.X <= 0.0f || localEnd.X > 0.0f) return false;
+
+	// Find where along the sweep the origin reaches the apertures plane.
+	float time = localStart.X / (localStart.X - localEnd.X);
+	FVector localCrossing = FMath::Lerp(localStart, localEnd, time);
+
+	// Grow the aperture by the box extent in the apertures space. NOTE: The rotated box fits within the summed extent.
+	FQuat rotation = aperture.GetRotation();
+	float boxExtentY = FVector::DotProduct(rotation.GetAxisY().GetAbs(), boxExtent);
+	float boxExtentZ = FVector::DotProduct(rotation.GetAxisZ().GetAbs(), boxExtent);
+	if (FMath::Abs(localCrossing.Y) > apertureExtent.X + boxExtentY || FMath::Abs(localCrossing.Z) > apertureExtent.Y + boxExtentZ) return false;
+	outTime = time;
+	return true;
+}
+
+bool FPortalMath::OverlapsOrientedBox(const FTransform& orientedBox, const FVector& orientedExtent, const FVector& center, const FVector& extent)
+{
+	// Grow the oriented box by the world box extent in its space. NOTE: The rotated box fits within the summed extent.
+	FVector localCenter = orientedBox.InverseTransformPositionNoScale(center);
+	FQuat rotation = orientedBox.GetRotation();
+	if (FMath::Abs(localCenter.X) > orientedExtent.X + FVector::DotProduct(rotation.GetAxisX().GetAbs(), extent)) return false;
+	if (FMath::Abs(localCenter.Y) > orientedExtent.Y + FVector::DotProduct(rotation.GetAxisY().GetAbs(), extent)) return false;
+	return FMath::Abs(localCenter.Z) <= orientedExtent.Z + FVector::DotProduct(rotation.GetAxisZ().GetAbs(), extent);
+}
+
+FPortalTransform::FPortalTransform()
+{
+	portalTransform = FTransform::Identity;
+	targetTransform = FTransform::Identity;
+	toTarget = FTransform::Identity;
+	toTargetMatrix = FMatrix::Identity;
+}
+
+bool FPortalTransform::Update(const FTransform& portal, const FTransform& target)
+{
+	// Ignore scale as the conversion functions do.
+	FTransform newPortalTransform = FTransform(portal.GetRotation(), portal.GetLocation());
+	FTransform newTargetTransform = FTransform(target.GetRotation(), target.GetLocation());
+	if (newPortalTransform.Equals(portalTransform, 0.0f) && newTargetTransform.Equals(targetTransform, 0.0f)) return false;
+	portalTransform = newPortalTransform;
+	targetTransform = newTargetTransform;
+
+	// Relative to the portal, flipped around its up axis so the forward and right axis are inverted, then back to world from the target.
+	FTransform flip = FTransform(FQuat(FVector::UpVector, PI));
+	toTarget = portalTransform.Inverse() * flip * targetTransform;
+	toTargetMatrix = toTarget.ToMatrixNoScale();
+	recursiveTransforms.Reset();
+	return true;
+}
+
+const FTransform& FPortalTransform::GetRecursiveTransform(int32 recursion)
+{
+	// Compose any recursions that haven't been needed since the portals last moved.
+	if (recursiveTransforms.Num() == 0) recursiveTransforms.Add(toTarget);
+	while (recursiveTransforms.Num() < recursion)
+	{
+		recursiveTransforms.Add(recursiveTransforms.Last() * toTarget);
+	}
+	return recursiveTransforms[FMath::Max(recursion, 1) - 1];
+}
+
+void FPortalTransform::TransformLocations(const FVector* locations, FVector* outLocations, int32 num) const
+{
+	for (int32 i = 0; i < num; i++)
+	{
+		VectorRegister location = VectorLoadFloat3_W1(&locations[i]);
+		VectorStoreFloat3(VectorTransformVector(location, &toTargetMatrix), &outLocations[i]);
+	}
+}
+
+void FPortalTransform::TransformDirections(const FVector* directions, FVector* outDirections, int32 num) const
+{
+	// NOTE: W of zero ignores the translation.
+	for (int32 i = 0; i < num; i++)
+	{
+		VectorRegister direction = VectorLoadFloat3_W0(&directions[i]);
+		VectorStoreFloat3(VectorTransformVector(direction, &toTargetMatrix), &outDirections[i]);
+	}
+}
+
+void FPortalTransform::TransformRotations(const FQuat* rotations, FQuat* outRotations, int32 num) const
+{
+	FQuat rotationToTarget = toTarget.GetRotation();
+	VectorRegister toTargetRotation = VectorLoadAligned(&rotationToTarget);
+	for (int32 i = 0; i < num; i++)
+	{
+		VectorRegister rotation = VectorLoad(&rotations[i]);
+		VectorStore(VectorQuaternionMultiply2(toTargetRotation, rotation), &outRotations[i]);
+	}
+}
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+#include "CoreMinimal.h"
+
+/* Static helper functions for the matrix maths used when rendering through portals.
+ * NOTE: All projection matrices are expected in the engines reversed Z format with an infinite far plane. */
+struct BETTERPORTALS_API FPortalMath
+{
+	/* Convert a world space plane into the view space of a camera at the given location and rotation.
+	 * NOTE: View space follows the projection matrix convention of X = right, Y = up and Z = forward. */
+	static FPlane WorldPlaneToView(const FPlane& worldPlane, const FVector& viewLocation, const FQuat& viewRotation);
+
+	/* Returns a copy of the projection matrix with its near plane replaced by the given view space clip plane.
+	 * Anything on the negative side of the plane is clipped by the projection itself so no global clip plane is needed.
+	 * NOTE: Returns the projection unchanged if the camera is on the positive side of the plane or it faces away from the frustum. */
+	static FMatrix MakeObliqueProjectionMatrix(const FMatrix& projection, const FPlane& viewClipPlane);
+
+	/* Build the view projection matrix for a camera at the given location and rotation. */
+	static FMatrix MakeViewProjectionMatrix(const FVector& viewLocation, const FQuat& viewRotation, const FMatrix& projection);
+
+	/* Project world space points to the screen and return their bounds in screen UV space clamped to 0-1.
+	 * Returns false if all of the points are outside of the frustum so nothing needs rendering.
+	 * NOTE: If every point is behind the camera false is returned, if only some are the whole screen is returned as the projection would wrap. */
+	static bool GetScreenBounds(const FMatrix& viewProjection, const FVector* points, int32 numPoints, FBox2D& outBounds);
+
+	/* Returns a copy of the projection matrix with its side planes moved in so only the given screen UV bounds are rendered.
+	 * NOTE: The cropped bounds fill the whole render target so screen UVs need remapping by GetScreenUVScaleBias. */
+	static FMatrix CropProjectionMatrix(const FMatrix& projection, const FBox2D& screenBounds);
+
+	/* Returns the scale in XY and bias in ZW to convert a full screen UV into the UV space of the given screen bounds. */
+	static FLinearColor GetScreenUVScaleBias(const FBox2D& screenBounds);
+
+	/* Build the matrix that takes a view space position of a previous view into the clip space of the current view.
+	 * NOTE: Used to reproject old captures to the current view using the depth stored in the captures alpha. */
+	static FMatrix MakeReprojectionMatrix(const FVector& previousLocation, const FQuat& previousRotation, const FMatrix& currentViewProjection);
+
+	/* Returns the values needed to unproject a clip space position with linear depth into view space for the given projection.
+	 * XY is one over the X and Y scale and ZW is the X and Y offset so viewXY = (clipXY - ZW) * XY * depth. */
+	static FLinearColor GetUnprojectParameters(const FMatrix& projection);
+
+	/* Returns the values needed to find the view depth from the scene depth a capture stores with the given projection.
+	 * The engine converts device Z to scene depth using only the depth column's Z and W terms so an oblique near plane bends the stored depth
+	 * by its X and Y terms. XY is those terms over the W term, ZW is unused. NOTE: Zero for projections without an oblique near plane. */
+	static FLinearColor GetDepthParameters(const FMatrix& captureProjection);
+
+	/* Find the view depth of a pixel at the clip space position from the scene depth its capture stored.
+	 * NOTE: Matches ReprojectUV in Shaders/PortalReprojection.usf. */
+	static float GetViewDepth(float sceneDepth, const FVector2D& clipPosition, const FLinearColor& unproject, const FLinearColor& depthParameters);
+
+	/* Sweep a box from the start to the end location and find if its origin crosses the aperture from front to back while the box
+	 * overlaps the apertures rectangle. Returns the time of impact from 0 at the start to 1 at the end in outTime.
+	 * NOTE: The aperture is in the Y and Z axis of its transform facing X, its extent is half its size in Y and Z, ignoring scale.
+	 *       The box is an axis aligned world extent such as a components bounds, a zero extent only tests its origin. */
+	static bool SweepThroughAperture(const FTransform& aperture, const FVector2D& apertureExtent, const FVector& start, const FVector& end,
+		const FVector& boxExtent, float& outTime);
+
+	/* Is an axis aligned world box overlapping a box oriented by the given transform at its center, ignoring scale.
+	 * NOTE: Only separates along the oriented boxes axis so near its edges it can report an overlap that isn't, fine for finding what might cross a portal. */
+	static bool OverlapsOrientedBox(const FTransform& orientedBox, const FVector& orientedExtent, const FVector& center, const FVector& extent);
+};
+
+/* Cached transform from a portal to its target portal so conversions don't rebuild both portals transforms every call.
+ * NOTE: Matches APortal::ConvertLocationToPortal and APortal::ConvertRotationToPortal with flip enabled, ignoring scale. */
+struct BETTERPORTALS_API FPortalTransform
+{
+private:
+
+	FTransform portalTransform; /* The portals transform without scale when last updated. */
+	FTransform targetTransform; /* The target portals transform without scale when last updated. */
+	FTransform toTarget; /* Transform from this portal to the target portal. */
+	FMatrix toTargetMatrix; /* Matrix version of toTarget for the batched functions. */
+	TArray<FTransform, TInlineAllocator<8>> recursiveTransforms; /* toTarget applied multiple times, index 0 is applied once. */
+
+public:
+
+	/* Default constructor. */
+	FPortalTransform();
+
+	/* Refresh the cached transform from the portals world transforms. Only rebuilt if either of the portals has moved.
+	 * Returns true if the cached transform was rebuilt. */
+	bool Update(const FTransform& portal, const FTransform& target);
+
+	/* Returns the transform from the portal to its target. */
+	FORCEINLINE const FTransform& GetTransform() const { return toTarget; }
+
+	/* Returns the transform from the portal to its target applied the given number of times, used for recursion.
+	 * NOTE: Composed from the previous recursion and cached until the portals move. */
+	const FTransform& GetRecursiveTransform(int32 recursion);
+
+	/* Convert a location to the target portal. */
+	FORCEINLINE FVector TransformLocation(const FVector& location) const { return toTarget.TransformPositionNoScale(location); }
+
+	/* Convert a direction such as a velocity to the target portal. */
+	FORCEINLINE FVector TransformDirection(const FVector& direction) const { return toTarget.TransformVectorNoScale(direction); }
+
+	/* Convert a rotation to the target portal. */
+	FORCEINLINE FQuat TransformRotation(const FQuat& rotation) const { return toTarget.GetRotation() * rotation; }
+
+	/* Convert an array of locations to the target portal using vector registers. NOTE: Input and output can be the same array. */
+	void TransformLocations(const FVector* locations, FVector* outLocations, int32 num) const;
+
+	/* Convert an array of directions to the target portal using vector registers. NOTE: Input and output can be the same array. */
+	void TransformDirections(const FVector* directions, FVector* outDirections, int32 num) const;
+
+	/* Convert an array of rotations to the target portal using vector registers. NOTE: Input and output can be the same array. */
+	void TransformRotations(const FQuat* rotations, FQuat* outRotations, int32 num) const;
+};
@@ -0,0 +1,466 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "PortalMath.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace PortalMathTests
+{
+	/* 90 degree reversed Z projection with an infinite far plane like the engine uses for captures. */
+	FMatrix MakeTestProjection()
+	{
+		return FReversedZPerspectiveMatrix(PI / 4.0f, 1920.0f, 1080.0f, 10.0f);
+	}
+
+	/* A portal and target pair at awkward angles with scale that the conversions should ignore. */
+	void MakeTestPortals(FTransform& outPortal, FTransform& outTarget)
+	{
+		outPortal = FTransform(FRotator(0.0f, 30.0f, 0.0f), FVector(100.0f, -250.0f, 50.0f), FVector(2.0f, 1.0f, 1.5f));
+		outTarget = FTransform(FRotator(10.0f, -120.0f, 5.0f), FVector(-900.0f, 400.0f, 300.0f), FVector(1.0f, 3.0f, 1.0f));
+	}
+
+	/* The per call maths APortal::ConvertLocationToPortal used before the transform was cached. */
+	FVector OldConvertLocation(const FVector& location, const FTransform& portal, const FTransform& target)
+	{
+		FVector posRelativeToPortal = portal.InverseTransformPositionNoScale(location);
+		posRelativeToPortal.X *= -1;
+		posRelativeToPortal.Y *= -1;
+		return target.TransformPositionNoScale(posRelativeToPortal);
+	}
+
+	/* The per call maths APortal::ConvertRotationToPortal used before the transform was cached. */
+	FQuat OldConvertRotation(const FQuat& rotation, const FTransform& portal, const FTransform& target)
+	{
+		FRotator relativeRotation = portal.InverseTransformRotation(rotation).Rotator();
+		relativeRotation.Yaw += 180.0f;
+		return target.TransformRotation(relativeRotation.Quaternion());
+	}
+
+	/* The per call maths APortal::ConvertDirectionToTarget used before the transform was cached. */
+	FVector OldConvertDirection(const FVector& direction, const FTransform& portal, const FTransform& target)
+	{
+		FQuat portalRotation = portal.GetRotation();
+		FQuat targetRotation = target.GetRotation();
+		float x = FVector::DotProduct(direction, portalRotation.GetForwardVector());
+		float y = FVector::DotProduct(direction, portalRotation.GetRightVector());
+		float z = FVector::DotProduct(direction, portalRotation.GetUpVector());
+		return x * -targetRotation.GetForwardVector() + y * -targetRotation.GetRightVector() + z * targetRotation.GetUpVector();
+	}
+
+	/* Are two rotations the same, compared by the axis they rotate to as a quaternion and its negative are the same rotation. */
+	bool RotationsMatch(const FQuat& a, const FQuat& b, float tolerance)
+	{
+		return a.GetForwardVector().Equals(b.GetForwardVector(), tolerance) && a.GetRightVector().Equals(b.GetRightVector(), tolerance)
+			&& a.GetUpVector().Equals(b.GetUpVector(), tolerance);
+	}
+
+	/* Screen UV of a clip space point. NOTE: Matches FPortalMath::GetScreenBounds. */
+	FVector2D ClipToScreenUV(const FVector4& clipPoint)
+	{
+		return FVector2D(clipPoint.X / clipPoint.W * 0.5f + 0.5f, 0.5f - clipPoint.Y / clipPoint.W * 0.5f);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathWorldPlaneToViewTest, "BetterPortals.PortalMath.WorldPlaneToView",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathWorldPlaneToViewTest::RunTest(const FString& Parameters)
+{
+	// Points on the world plane must stay on the plane in view space (X = right, Y = up, Z = forward).
+	FVector viewLocation = FVector(120.0f, -340.0f, 75.0f);
+	FQuat viewRotation = FRotator(-15.0f, 35.0f, 10.0f).Quaternion();
+	FVector normal = FVector(0.6f, -0.3f, 0.2f).GetSafeNormal();
+	FPlane worldPlane = FPlane(FVector(400.0f, 50.0f, -20.0f), normal);
+	FPlane viewPlane = FPortalMath::WorldPlaneToView(worldPlane, viewLocation, viewRotation);
+
+	FVector tangentA = FVector::CrossProduct(normal, FVector::UpVector).GetSafeNormal();
+	FVector tangentB = FVector::CrossProduct(normal, tangentA);
+	FVector worldPoints[4] = { FVector(400.0f, 50.0f, -20.0f), FVector(400.0f, 50.0f, -20.0f) + tangentA * 250.0f,
+		FVector(400.0f, 50.0f, -20.0f) + tangentB * 130.0f, FVector(400.0f, 50.0f, -20.0f) + normal * 60.0f };
+	for (int32 i = 0; i < 4; i++)
+	{
+		FVector relative = worldPoints[i] - viewLocation;
+		FVector viewPoint = FVector(FVector::DotProduct(relative, viewRotation.GetRightVector()), FVector::DotProduct(relative, viewRotation.GetUpVector()),
+			FVector::DotProduct(relative, viewRotation.GetForwardVector()));
+		TestEqual(TEXT("View plane distance matches the world plane distance"), viewPlane.PlaneDot(viewPoint), worldPlane.PlaneDot(worldPoints[i]), 0.01f);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathObliqueProjectionTest, "BetterPortals.PortalMath.MakeObliqueProjectionMatrix",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathObliqueProjectionTest::RunTest(const FString& Parameters)
+{
+	FMatrix projection = PortalMathTests::MakeTestProjection();
+	FVector viewLocation = FVector::ZeroVector;
+	FQuat viewRotation = FQuat::Identity;
+
+	// A tilted plane in front of the camera facing away from it, everything past the plane is visible.
+	FVector normal = FVector(1.0f, 0.3f, 0.2f).GetSafeNormal();
+	FVector planePoint = normal * 300.0f;
+	FPlane worldPlane = FPlane(planePoint, normal);
+	FPlane viewPlane = FPortalMath::WorldPlaneToView(worldPlane, viewLocation, viewRotation);
+	FMatrix obliqueProjection = FPortalMath::MakeObliqueProjectionMatrix(projection, viewPlane);
+	FMatrix viewProjection = FPortalMath::MakeViewProjectionMatrix(viewLocation, viewRotation, obliqueProjection);
+
+	// Points on the plane land on the reversed Z near plane where depth == w.
+	FVector tangentA = FVector::CrossProduct(normal, FVector::UpVector).GetSafeNormal();
+	FVector tangentB = FVector::CrossProduct(normal, tangentA);
+	FVector onPlane[3] = { planePoint, planePoint + tangentA * 80.0f, planePoint - tangentB * 60.0f };
+	for (const FVector& point : onPlane)
+	{
+		FVector4 clipPoint = viewProjection.TransformFVector4(FVector4(point, 1.0f));
+		TestTrue(TEXT("Point on the plane is in front of the camera"), clipPoint.W > 0.0f);
+		TestEqual(TEXT("Point on the plane has depth == w"), clipPoint.Z, clipPoint.W, clipPoint.W * 0.001f);
+	}
+
+	// Points behind the plane are clipped (depth > w), points past it are kept (0 <= depth < w).
+	FVector4 behind = viewProjection.TransformFVector4(FVector4(planePoint - normal * 50.0f, 1.0f));
+	FVector4 past = viewProjection.TransformFVector4(FVector4(planePoint + normal * 50.0f, 1.0f));
+	TestTrue(TEXT("Point behind the plane is clipped"), behind.Z > behind.W);
+	TestTrue(TEXT("Point past the plane is not clipped"), past.Z < past.W && past.Z >= 0.0f);
+
+	// X and Y are untouched so the image doesn't move.
+	FVector4 unclipped = FPortalMath::MakeViewProjectionMatrix(viewLocation, viewRotation, projection).TransformFVector4(FVector4(planePoint, 1.0f));
+	FVector4 clipped = viewProjection.TransformFVector4(FVector4(planePoint, 1.0f));
+	TestEqual(TEXT("Oblique projection keeps X"), clipped.X, unclipped.X, 0.001f);
+	TestEqual(TEXT("Oblique projection keeps Y"), clipped.Y, unclipped.Y, 0.001f);
+
+	// A camera in front of the plane gets the projection back unchanged.
+	FPlane facingPlane = FPortalMath::WorldPlaneToView(FPlane(planePoint, -normal), viewLocation, viewRotation);
+	TestTrue(TEXT("Camera on the visible side keeps its projection"), FPortalMath::MakeObliqueProjectionMatrix(projection, facingPlane).Equals(projection, 0.0f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathCropProjectionTest, "BetterPortals.PortalMath.CropProjectionMatrix",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathCropProjectionTest::RunTest(const FString& Parameters)
+{
+	FMatrix projection = PortalMathTests::MakeTestProjection();
+	FBox2D screenBounds = FBox2D(FVector2D(0.2f, 0.35f), FVector2D(0.6f, 0.9f));
+	FMatrix cropped = FPortalMath::CropProjectionMatrix(projection, screenBounds);
+	FLinearColor scaleBias = FPortalMath::GetScreenUVScaleBias(screenBounds);
+
+	// A cropped point is where the full screen UV lands after the UV scale and bias the portal material applies.
+	FVector points[4] = { FVector(500.0f, -80.0f, 40.0f), FVector(900.0f, 300.0f, -200.0f), FVector(250.0f, 0.0f, 0.0f), FVector(1200.0f, -700.0f, 350.0f) };
+	for (const FVector& point : points)
+	{
+		FVector4 viewPoint = FVector4(point.Y, point.Z, point.X, 1.0f);
+		FVector2D fullUV = PortalMathTests::ClipToScreenUV(projection.TransformFVector4(viewPoint));
+		FVector4 croppedClip = cropped.TransformFVector4(viewPoint);
+		FVector2D croppedUV = PortalMathTests::ClipToScreenUV(croppedClip);
+		TestEqual(TEXT("Cropped U matches the remapped full screen U"), croppedUV.X, fullUV.X * scaleBias.R + scaleBias.B, 0.001f);
+		TestEqual(TEXT("Cropped V matches the remapped full screen V"), croppedUV.Y, fullUV.Y * scaleBias.G + scaleBias.A, 0.001f);
+		TestEqual(TEXT("Cropping keeps depth"), croppedClip.Z, projection.TransformFVector4(viewPoint).Z, 0.0001f);
+	}
+
+	// The corners of the bounds map to the corners of the cropped target.
+	TestEqual(TEXT("Bounds min U maps to 0"), screenBounds.Min.X * scaleBias.R + scaleBias.B, 0.0f, 0.0001f);
+	TestEqual(TEXT("Bounds min V maps to 0"), screenBounds.Min.Y * scaleBias.G + scaleBias.A, 0.0f, 0.0001f);
+	TestEqual(TEXT("Bounds max U maps to 1"), screenBounds.Max.X * scaleBias.R + scaleBias.B, 1.0f, 0.0001f);
+	TestEqual(TEXT("Bounds max V maps to 1"), screenBounds.Max.Y * scaleBias.G + scaleBias.A, 1.0f, 0.0001f);
+
+	// Empty bounds leave the projection alone.
+	TestTrue(TEXT("Empty bounds keep the projection"), FPortalMath::CropProjectionMatrix(projection, FBox2D(FVector2D(0.5f, 0.5f), FVector2D(0.5f, 0.5f))).Equals(projection, 0.0f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathScreenBoundsTest, "BetterPortals.PortalMath.GetScreenBounds",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathScreenBoundsTest::RunTest(const FString& Parameters)
+{
+	FMatrix viewProjection = FPortalMath::MakeViewProjectionMatrix(FVector::ZeroVector, FQuat::Identity, PortalMathTests::MakeTestProjection());
+	float aspect = 1920.0f / 1080.0f;
+
+	// A square straight ahead covers the middle of the screen. NOTE: 90 degree horizontal FOV so X == distance is the screen edge.
+	FVector square[4] = { FVector(1000.0f, -250.0f, -250.0f), FVector(1000.0f, 250.0f, -250.0f), FVector(1000.0f, 250.0f, 250.0f), FVector(1000.0f, -250.0f, 250.0f) };
+	FBox2D bounds;
+	TestTrue(TEXT("Square ahead is visible"), FPortalMath::GetScreenBounds(viewProjection, square, 4, bounds));
+	TestEqual(TEXT("Square min U"), bounds.Min.X, 0.375f, 0.001f);
+	TestEqual(TEXT("Square min V"), bounds.Min.Y, 0.5f - 0.125f * aspect, 0.001f);
+	TestEqual(TEXT("Square max U"), bounds.Max.X, 0.625f, 0.001f);
+	TestEqual(TEXT("Square max V"), bounds.Max.Y, 0.5f + 0.125f * aspect, 0.001f);
+
+	// Partly off screen is clamped to the screen.
+	FVector offRight[4] = { FVector(1000.0f, 800.0f, -100.0f), FVector(1000.0f, 1600.0f, -100.0f), FVector(1000.0f, 1600.0f, 100.0f), FVector(1000.0f, 800.0f, 100.0f) };
+	TestTrue(TEXT("Partly visible quad is visible"), FPortalMath::GetScreenBounds(viewProjection, offRight, 4, bounds));
+	TestEqual(TEXT("Partly visible quad is clamped to the right edge"), bounds.Max.X, 1.0f, 0.0001f);
+	TestEqual(TEXT("Partly visible quad starts on screen"), bounds.Min.X, 0.9f, 0.001f);
+
+	// Entirely off one side is not visible.
+	FVector offLeft[4] = { FVector(1000.0f, -1200.0f, -100.0f), FVector(1000.0f, -1100.0f, -100.0f), FVector(1000.0f, -1100.0f, 100.0f), FVector(1000.0f, -1200.0f, 100.0f) };
+	TestFalse(TEXT("Quad left of the frustum is not visible"), FPortalMath::GetScreenBounds(viewProjection, offLeft, 4, bounds));
+
+	// A point behind the camera falls back to the whole screen.
+	FVector behind[2] = { FVector(1000.0f, 0.0f, 0.0f), FVector(-50.0f, 0.0f, 0.0f) };
+	TestTrue(TEXT("Quad crossing behind the camera is visible"), FPortalMath::GetScreenBounds(viewProjection, behind, 2, bounds));
+	TestTrue(TEXT("Quad crossing behind the camera covers the screen"), bounds.Min == FVector2D(0.0f, 0.0f) && bounds.Max == FVector2D(1.0f, 1.0f));
+
+	// A quad entirely behind the camera is not visible.
+	FVector allBehind[4] = { FVector(-500.0f, -250.0f, -250.0f), FVector(-500.0f, 250.0f, -250.0f), FVector(-500.0f, 250.0f, 250.0f), FVector(-500.0f, -250.0f, 250.0f) };
+	TestFalse(TEXT("Quad behind the camera is not visible"), FPortalMath::GetScreenBounds(viewProjection, allBehind, 4, bounds));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathReprojectionTest, "BetterPortals.PortalMath.Reprojection",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathReprojectionTest::RunTest(const FString& Parameters)
+{
+	// A cropped capture from a previous view and the current view cropped to the same bounds like APortal::ReprojectPortalView.
+	FBox2D captureBounds = FBox2D(FVector2D(0.1f, 0.2f), FVector2D(0.7f, 0.8f));
+	FMatrix projection = FPortalMath::CropProjectionMatrix(PortalMathTests::MakeTestProjection(), captureBounds);
+	FVector previousLocation = FVector(-50.0f, 20.0f, 10.0f);
+	FQuat previousRotation = FRotator(-5.0f, 10.0f, 0.0f).Quaternion();
+	FVector currentLocation = FVector(-20.0f, 45.0f, 0.0f);
+	FQuat currentRotation = FRotator(0.0f, 14.0f, 2.0f).Quaternion();
+	FMatrix previousViewProjection = FPortalMath::MakeViewProjectionMatrix(previousLocation, previousRotation, projection);
+	FMatrix currentViewProjection = FPortalMath::MakeViewProjectionMatrix(currentLocation, currentRotation, projection);
+	FMatrix reprojection = FPortalMath::MakeReprojectionMatrix(previousLocation, previousRotation, currentViewProjection);
+	FLinearColor unproject = FPortalMath::GetUnprojectParameters(projection);
+
+	// A world point unprojected from its previous clip position and linear depth lands where the current view sees it.
+	// NOTE: Matches ReprojectUV in PortalReprojection.usf, linear depth is the clip W of the previous view.
+	FVector points[3] = { FVector(800.0f, 60.0f, 40.0f), FVector(1500.0f, -200.0f, 180.0f), FVector(400.0f, 90.0f, -60.0f) };
+	for (const FVector& point : points)
+	{
+		FVector4 previousClip = previousViewProjection.TransformFVector4(FVector4(point, 1.0f));
+		float depth = previousClip.W;
+		FVector2D previousNDC = FVector2D(previousClip.X / depth, previousClip.Y / depth);
+		FVector4 viewPoint = FVector4((previousNDC.X - unproject.B) * unproject.R * depth, (previousNDC.Y - unproject.A) * unproject.G * depth, depth, 1.0f);
+		FVector2D reprojectedUV = PortalMathTests::ClipToScreenUV(reprojection.TransformFVector4(viewPoint));
+		FVector2D currentUV = PortalMathTests::ClipToScreenUV(currentViewProjection.TransformFVector4(FVector4(point, 1.0f)));
+		TestEqual(TEXT("Reprojected U matches the current view"), reprojectedUV.X, currentUV.X, 0.001f);
+		TestEqual(TEXT("Reprojected V matches the current view"), reprojectedUV.Y, currentUV.Y, 0.001f);
+	}
+
+	// Reprojecting to the same view leaves every point where it was.
+	FMatrix sameView = FPortalMath::MakeReprojectionMatrix(previousLocation, previousRotation, previousViewProjection);
+	FVector4 stillClip = sameView.TransformFVector4(FVector4(100.0f, -40.0f, 600.0f, 1.0f));
+	FVector4 stillExpected = projection.TransformFVector4(FVector4(100.0f, -40.0f, 600.0f, 1.0f));
+	TestEqual(TEXT("Same view keeps X"), stillClip.X / stillClip.W, stillExpected.X / stillExpected.W, 0.0001f);
+	TestEqual(TEXT("Same view keeps Y"), stillClip.Y / stillClip.W, stillExpected.Y / stillExpected.W, 0.0001f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathObliqueDepthTest, "BetterPortals.PortalMath.ObliqueDepth",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathObliqueDepthTest::RunTest(const FString& Parameters)
+{
+	// A cropped capture with a tilted oblique near plane like APortal::CapturePortalView.
+	FMatrix projection = FPortalMath::CropProjectionMatrix(PortalMathTests::MakeTestProjection(), FBox2D(FVector2D(0.1f, 0.2f), FVector2D(0.7f, 0.8f)));
+	FVector normal = FVector(1.0f, 0.4f, -0.3f).GetSafeNormal();
+	FVector planePoint = normal * 200.0f;
+	FPlane viewPlane = FPortalMath::WorldPlaneToView(FPlane(planePoint, normal), FVector::ZeroVector, FQuat::Identity);
+	FMatrix obliqueProjection = FPortalMath::MakeObliqueProjectionMatrix(projection, viewPlane);
+	FMatrix viewProjection = FPortalMath::MakeViewProjectionMatrix(FVector::ZeroVector, FQuat::Identity, obliqueProjection);
+	FLinearColor unproject = FPortalMath::GetUnprojectParameters(projection);
+	FLinearColor depthParameters = FPortalMath::GetDepthParameters(obliqueProjection);
+
+	// Store the scene depth the way the engine converts device Z with only the depth columns Z and W terms, then solve it back to view depth.
+	// NOTE: The points are inside of the oblique frustum so their device Z is between 0 and 1.
+	FVector points[3] = { FVector(1600.0f, -150.0f, 120.0f), FVector(2000.0f, -300.0f, 200.0f), FVector(1200.0f, -120.0f, 60.0f) };
+	for (const FVector& point : points)
+	{
+		FVector4 clipPoint = viewProjection.TransformFVector4(FVector4(point, 1.0f));
+		float deviceZ = clipPoint.Z / clipPoint.W;
+		TestTrue(TEXT("Point is inside of the oblique frustum"), deviceZ > 0.0f && deviceZ < 1.0f);
+		float sceneDepth = obliqueProjection.M[3][2] / (deviceZ - obliqueProjection.M[2][2]);
+		FVector2D clipPosition = FVector2D(clipPoint.X / clipPoint.W, clipPoint.Y / clipPoint.W);
+		TestFalse(TEXT("Oblique scene depth isn't the view depth"), FMath::IsNearlyEqual(sceneDepth, clipPoint.W, clipPoint.W * 0.01f));
+		TestEqual(TEXT("View depth is found from the oblique scene depth"), FPortalMath::GetViewDepth(sceneDepth, clipPosition, unproject, depthParameters), clipPoint.W, clipPoint.W * 0.001f);
+	}
+
+	// Without an oblique near plane the scene depth already is the view depth.
+	FLinearColor flatParameters = FPortalMath::GetDepthParameters(projection);
+	TestEqual(TEXT("Flat projection has no depth parameters"), FVector2D(flatParameters.R, flatParameters.G), FVector2D::ZeroVector);
+	TestEqual(TEXT("Flat projection keeps the scene depth"), FPortalMath::GetViewDepth(750.0f, FVector2D(0.3f, -0.2f), unproject, flatParameters), 750.0f, 0.01f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathSweepThroughApertureTest, "BetterPortals.PortalMath.SweepThroughAperture",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathSweepThroughApertureTest::RunTest(const FString& Parameters)
+{
+	// A turned and moved aperture so its local axis differ from the world axis. NOTE: Its local Y is world -X and its local Z is world Z.
+	FTransform aperture = FTransform(FRotator(0.0f, 90.0f, 0.0f), FVector(500.0f, 200.0f, 0.0f));
+	FVector2D apertureExtent = FVector2D(100.0f, 150.0f);
+	float time = -1.0f;
+
+	// Front to back inside the aperture crosses a quarter of the way along the sweep.
+	FVector start = aperture.TransformPositionNoScale(FVector(100.0f, 20.0f, 30.0f));
+	FVector end = aperture.TransformPositionNoScale(FVector(-300.0f, 20.0f, 30.0f));
+	TestTrue(TEXT("Front to back inside the aperture crosses"), FPortalMath::SweepThroughAperture(aperture, apertureExtent, start, end, FVector::ZeroVector, time));
+	TestEqual(TEXT("Time of impact is where the origin reaches the plane"), time, 0.25f, 0.0001f);
+
+	// Back to front is rejected.
+	TestFalse(TEXT("Back to front doesn't cross"), FPortalMath::SweepThroughAperture(aperture, apertureExtent, end, start, FVector::ZeroVector, time));
+
+	// The aperture is grown by the box extent along its axis. NOTE: The world X extent is along the apertures Y.
+	FVector boxExtent = FVector(10.0f, 20.0f, 5.0f);
+	FVector insideGrown = FVector(-50.0f, 108.0f, 0.0f);
+	FVector outsideGrown = FVector(-50.0f, 112.0f, 0.0f);
+	TestTrue(TEXT("Box overlapping the aperture edge crosses"), FPortalMath::SweepThroughAperture(aperture, apertureExtent,
+		aperture.TransformPositionNoScale(insideGrown + FVector(100.0f, 0.0f, 0.0f)), aperture.TransformPositionNoScale(insideGrown), boxExtent, time));
+	TestFalse(TEXT("Box outside the grown aperture misses"), FPortalMath::SweepThroughAperture(aperture, apertureExtent,
+		aperture.TransformPositionNoScale(outsideGrown + FVector(100.0f, 0.0f, 0.0f)), aperture.TransformPositionNoScale(outsideGrown), boxExtent, time));
+	TestFalse(TEXT("Box above the grown aperture misses"), FPortalMath::SweepThroughAperture(aperture, apertureExtent,
+		aperture.TransformPositionNoScale(FVector(50.0f, 0.0f, 156.0f)), aperture.TransformPositionNoScale(FVector(-50.0f, 0.0f, 156.0f)), boxExtent, time));
+
+	// A fast body that starts just in front and lands far past the plane in one step still crosses near the start of the sweep.
+	start = aperture.TransformPositionNoScale(FVector(50.0f, -40.0f, 0.0f));
+	end = aperture.TransformPositionNoScale(FVector(-5000.0f, -40.0f, 0.0f));
+	TestTrue(TEXT("Fast body past the plane in one step crosses"), FPortalMath::SweepThroughAperture(aperture, apertureExtent, start, end, boxExtent, time));
+	TestEqual(TEXT("Fast body time of impact"), time, 50.0f / 5050.0f, 0.0001f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalMathOverlapsOrientedBoxTest, "BetterPortals.PortalMath.OverlapsOrientedBox",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalMathOverlapsOrientedBoxTest::RunTest(const FString& Parameters)
+{
+	// The same turned box as the aperture test. NOTE: Its local X is world Y and its local Y is world -X.
+	FTransform orientedBox = FTransform(FRotator(0.0f, 90.0f, 0.0f), FVector(500.0f, 200.0f, 0.0f));
+	FVector orientedExtent = FVector(50.0f, 100.0f, 150.0f);
+	FVector extent = FVector(10.0f, 20.0f, 5.0f);
+
+	TestTrue(TEXT("Box at the center overlaps"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.GetLocation(), extent));
+
+	// Each axis is grown by the world box extent along it.
+	TestTrue(TEXT("Box within the grown X overlaps"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.TransformPositionNoScale(FVector(65.0f, 0.0f, 0.0f)), extent));
+	TestFalse(TEXT("Box past the grown X doesn't overlap"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.TransformPositionNoScale(FVector(75.0f, 0.0f, 0.0f)), extent));
+	TestTrue(TEXT("Box within the grown Y overlaps"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.TransformPositionNoScale(FVector(0.0f, -108.0f, 0.0f)), extent));
+	TestFalse(TEXT("Box past the grown Y doesn't overlap"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.TransformPositionNoScale(FVector(0.0f, -112.0f, 0.0f)), extent));
+	TestTrue(TEXT("Box within the grown Z overlaps"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.TransformPositionNoScale(FVector(0.0f, 0.0f, 154.0f)), extent));
+	TestFalse(TEXT("Box past the grown Z doesn't overlap"), FPortalMath::OverlapsOrientedBox(orientedBox, orientedExtent, orientedBox.TransformPositionNoScale(FVector(0.0f, 0.0f, 156.0f)), extent));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalTransformTest, "BetterPortals.PortalMath.PortalTransform",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalTransformTest::RunTest(const FString& Parameters)
+{
+	FTransform portal, target;
+	PortalMathTests::MakeTestPortals(portal, target);
+	FPortalTransform portalTransform;
+	TestTrue(TEXT("First update rebuilds the transform"), portalTransform.Update(portal, target));
+	TestFalse(TEXT("Unmoved portals keep the cached transform"), portalTransform.Update(portal, target));
+
+	// Single conversions match the old per call maths.
+	FRandomStream random(1234);
+	const int32 numSamples = 64;
+	TArray<FVector> locations, directions;
+	TArray<FQuat> rotations;
+	for (int32 i = 0; i < numSamples; i++)
+	{
+		locations.Add(random.VRand() * random.FRandRange(0.0f, 2000.0f));
+		directions.Add(random.VRand() * random.FRandRange(0.0f, 800.0f));
+		rotations.Add(FRotator(random.FRandRange(-89.0f, 89.0f), random.FRandRange(-180.0f, 180.0f), random.FRandRange(-180.0f, 180.0f)).Quaternion());
+	}
+	for (int32 i = 0; i < numSamples; i++)
+	{
+		TestEqual(TEXT("TransformLocation matches ConvertLocationToPortal"), portalTransform.TransformLocation(locations[i]),
+			PortalMathTests::OldConvertLocation(locations[i], portal, target), 0.01f);
+		TestEqual(TEXT("TransformDirection matches ConvertDirectionToTarget"), portalTransform.TransformDirection(directions[i]),
+			PortalMathTests::OldConvertDirection(directions[i], portal, target), 0.01f);
+		TestTrue(TEXT("TransformRotation matches ConvertRotationToPortal"),
+			PortalMathTests::RotationsMatch(portalTransform.TransformRotation(rotations[i]), PortalMathTests::OldConvertRotation(rotations[i], portal, target), 0.001f));
+	}
+
+	// The batched vector register versions match the single conversions, including in place.
+	TArray<FVector> batchLocations = locations;
+	TArray<FVector> batchDirections;
+	batchDirections.SetNum(numSamples);
+	TArray<FQuat> batchRotations = rotations;
+	portalTransform.TransformLocations(batchLocations.GetData(), batchLocations.GetData(), numSamples);
+	portalTransform.TransformDirections(directions.GetData(), batchDirections.GetData(), numSamples);
+	portalTransform.TransformRotations(batchRotations.GetData(), batchRotations.GetData(), numSamples);
+	for (int32 i = 0; i < numSamples; i++)
+	{
+		TestEqual(TEXT("TransformLocations matches TransformLocation"), batchLocations[i], portalTransform.TransformLocation(locations[i]), 0.01f);
+		TestEqual(TEXT("TransformDirections matches TransformDirection"), batchDirections[i], portalTransform.TransformDirection(directions[i]), 0.01f);
+		TestTrue(TEXT("TransformRotations matches TransformRotation"), PortalMathTests::RotationsMatch(batchRotations[i], portalTransform.TransformRotation(rotations[i]), 0.001f));
+	}
+
+	// Recursive transforms match converting through the portal that many times.
+	for (int32 recursion = 1; recursion <= 4; recursion++)
+	{
+		FVector stepped = locations[0];
+		for (int32 step = 0; step < recursion; step++) stepped = PortalMathTests::OldConvertLocation(stepped, portal, target);
+		FTransform recursive = portalTransform.GetRecursiveTransform(recursion);
+		TestEqual(FString::Printf(TEXT("Recursion %d matches converting %d times"), recursion, recursion), recursive.TransformPositionNoScale(locations[0]), stepped, 0.05f);
+	}
+
+	// Moving a portal rebuilds the transform and its recursions.
+	FTransform movedTarget = target;
+	movedTarget.AddToTranslation(FVector(0.0f, 0.0f, 500.0f));
+	TestTrue(TEXT("Moved portal rebuilds the transform"), portalTransform.Update(portal, movedTarget));
+	TestEqual(TEXT("Rebuilt transform uses the moved portal"), portalTransform.TransformLocation(locations[0]),
+		PortalMathTests::OldConvertLocation(locations[0], portal, movedTarget), 0.01f);
+	TestEqual(TEXT("Rebuilt recursion uses the moved portal"), portalTransform.GetRecursiveTransform(2).TransformPositionNoScale(locations[0]),
+		PortalMathTests::OldConvertLocation(PortalMathTests::OldConvertLocation(locations[0], portal, movedTarget), portal, movedTarget), 0.05f);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalTransformBenchmark, "BetterPortals.PortalMath.PortalTransformBenchmark",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FPortalTransformBenchmark::RunTest(const FString& Parameters)
+{
+	FTransform portal, target;
+	PortalMathTests::MakeTestPortals(portal, target);
+	FPortalTransform portalTransform;
+	portalTransform.Update(portal, target);
+
+	// Enough locations and rotations to take a measurable time.
+	const int32 numSamples = 100000;
+	FRandomStream random(5678);
+	TArray<FVector> locations, outLocations;
+	TArray<FQuat> rotations, outRotations;
+	locations.SetNumUninitialized(numSamples);
+	rotations.SetNumUninitialized(numSamples);
+	outLocations.SetNumUninitialized(numSamples);
+	outRotations.SetNumUninitialized(numSamples);
+	for (int32 i = 0; i < numSamples; i++)
+	{
+		locations[i] = random.VRand() * 1000.0f;
+		rotations[i] = FRotator(random.FRandRange(-89.0f, 89.0f), random.FRandRange(-180.0f, 180.0f), 0.0f).Quaternion();
+	}
+
+	// The old per call maths.
+	double startTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < numSamples; i++)
+	{
+		outLocations[i] = PortalMathTests::OldConvertLocation(locations[i], portal, target);
+		outRotations[i] = PortalMathTests::OldConvertRotation(rotations[i], portal, target);
+	}
+	double oldTime = FPlatformTime::Seconds() - startTime;
+
+	// The cached transform one at a time.
+	startTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < numSamples; i++)
+	{
+		outLocations[i] = portalTransform.TransformLocation(locations[i]);
+		outRotations[i] = portalTransform.TransformRotation(rotations[i]);
+	}
+	double cachedTime = FPlatformTime::Seconds() - startTime;
+
+	// The cached transform batched through vector registers.
+	startTime = FPlatformTime::Seconds();
+	portalTransform.TransformLocations(locations.GetData(), outLocations.GetData(), numSamples);
+	portalTransform.TransformRotations(rotations.GetData(), outRotations.GetData(), numSamples);
+	double batchTime = FPlatformTime::Seconds() - startTime;
+
+	AddInfo(FString::Printf(TEXT("%d conversions: old %.3fms, cached %.3fms, batched %.3fms."), numSamples, oldTime * 1000.0, cachedTime * 1000.0, batchTime * 1000.0));
+	return true;
+}
+
+#endif
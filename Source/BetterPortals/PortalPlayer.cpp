@@ -2,6 +2,9 @@
 #include "PortalPlayer.h"
 #include "Engine/LocalPlayer.h"
 #include "SceneView.h"
+#include "Engine/Engine.h"
+#include "UnrealClient.h"
+#include "Engine/GameViewportClient.h"
 
 UPortalPlayer::UPortalPlayer()
 {
@@ -20,11 +23,22 @@ void UPortalPlayer::CameraCut()
 	camCut = true;
 }
 
-FMatrix UPortalPlayer::GetCameraProjectionMatrix()
+bool UPortalPlayer::IsStereoEnabled()
+{
+	return GEngine && GEngine->IsStereoscopic3D(ViewportClient ? ViewportClient->Viewport : nullptr);
+}
+
+bool UPortalPlayer::GetCameraProjectionData(EStereoscopicPass stereoPass, FSceneViewProjectionData& outProjectionData)
+{
+	if (!ViewportClient || !ViewportClient->Viewport) return false;
+	return GetProjectionData(ViewportClient->Viewport, stereoPass, outProjectionData);
+}
+
+FMatrix UPortalPlayer::GetCameraProjectionMatrix(EStereoscopicPass stereoPass)
 {
 	FMatrix projMatrix;
 	FSceneViewProjectionData projData;
-	GetProjectionData(ViewportClient->Viewport, EStereoscopicPass::eSSP_FULL, projData);//EStereoscopicPass::eSSP_RIGHT_EYE VR matrix copy...
+	GetProjectionData(ViewportClient->Viewport, stereoPass, projData);
 	projMatrix = projData.ProjectionMatrix;
 	return projMatrix;
 }
@@ -4,6 +4,8 @@
 #include "Engine/LocalPlayer.h"
 #include "PortalPlayer.generated.h"
 
+struct FSceneViewProjectionData;
+
 /* New local player class to add camera cutting to the view settings and projection matrix retrieval functions. */
 UCLASS()
 class BETTERPORTALS_API UPortalPlayer : public ULocalPlayer
@@ -25,6 +27,12 @@ public:
 	/* Cut the camera's frame. */
 	void CameraCut();
 
+	/* Is the player rendering in stereo, also true when emulating stereo without a HMD. */
+	bool IsStereoEnabled();
+
+	/* Get the cameras projection data for the given stereo pass. Returns false if there is no viewport. */
+	bool GetCameraProjectionData(EStereoscopicPass stereoPass, FSceneViewProjectionData& outProjectionData);
+
 	/* Get the cameras projection matrix. */
-	FMatrix GetCameraProjectionMatrix();
+	FMatrix GetCameraProjectionMatrix(EStereoscopicPass stereoPass = EStereoscopicPass::eSSP_FULL);
 };
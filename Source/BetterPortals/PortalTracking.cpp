@@ -0,0 +1,159 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "PortalTracking.h"
+#include "GameFramework/Actor.h"
+#include "Components/SceneComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+
+FTrackedActorHandle FTrackedActorSet::Add(AActor* actor, USceneComponent* component, const FVector& origin)
+{
+	if (const int32* existingSlot = actorSlots.Find(actor)) return FTrackedActorHandle(*existingSlot, slotGenerations[*existingSlot]);
+
+	// Reuse a free slot if there is one.
+	int32 slot;
+	if (freeSlots.Num() > 0) slot = freeSlots.Pop(false);
+	else
+	{
+		slot = slotIndices.Add(INDEX_NONE);
+		slotGenerations.Add(0);
+	}
+
+	// Add to the end of the dense arrays.
+	int32 index = actors.Add(actor);
+	components.Add(component);
+	duplicates.Add(nullptr);
+	lastOrigins.Add(origin);
+	instancers.Add(INDEX_NONE);
+	instances.Add(INDEX_NONE);
+	substepIndices.Add(INDEX_NONE);
+	denseSlots.Add(slot);
+	slotIndices[slot] = index;
+	actorSlots.Add(actor, slot);
+	return FTrackedActorHandle(slot, slotGenerations[slot]);
+}
+
+bool FTrackedActorSet::Remove(const FTrackedActorHandle& handle)
+{
+	int32 index = GetIndex(handle);
+	if (index == INDEX_NONE) return false;
+	actorSlots.Remove(actors[index]);
+	if (duplicates[index]) duplicateSlots.Remove(duplicates[index]);
+
+	// Move the last actor into the removed index and point its slot at it.
+	actors.RemoveAtSwap(index, 1, false);
+	components.RemoveAtSwap(index, 1, false);
+	duplicates.RemoveAtSwap(index, 1, false);
+	lastOrigins.RemoveAtSwap(index, 1, false);
+	instancers.RemoveAtSwap(index, 1, false);
+	instances.RemoveAtSwap(index, 1, false);
+	substepIndices.RemoveAtSwap(index, 1, false);
+	denseSlots.RemoveAtSwap(index, 1, false);
+	if (denseSlots.IsValidIndex(index)) slotIndices[denseSlots[index]] = index;
+
+	// Free the slot. NOTE: The new generation makes any handles still pointing at it stale.
+	slotIndices[handle.slot] = INDEX_NONE;
+	slotGenerations[handle.slot]++;
+	freeSlots.Add(handle.slot);
+	return true;
+}
+
+void FTrackedActorSet::SetDuplicate(const FTrackedActorHandle& handle, AActor* duplicate)
+{
+	int32 index = GetIndex(handle);
+	if (index == INDEX_NONE) return;
+	if (duplicates[index]) duplicateSlots.Remove(duplicates[index]);
+	duplicates[index] = duplicate;
+	if (duplicate) duplicateSlots.Add(duplicate, handle.slot);
+}
+
+void FTrackedActorSet::SetInstance(const FTrackedActorHandle& handle, int32 instancer, int32 instance)
+{
+	int32 index = GetIndex(handle);
+	if (index == INDEX_NONE) return;
+	instancers[index] = instancer;
+	instances[index] = instancer == INDEX_NONE ? INDEX_NONE : instance;
+}
+
+FTrackedActorHandle FTrackedActorSet::Find(AActor* actor) const
+{
+	const int32* slot = actorSlots.Find(actor);
+	return slot ? FTrackedActorHandle(*slot, slotGenerations[*slot]) : FTrackedActorHandle();
+}
+
+FTrackedActorHandle FTrackedActorSet::FindByDuplicate(AActor* duplicate) const
+{
+	const int32* slot = duplicateSlots.Find(duplicate);
+	return slot ? FTrackedActorHandle(*slot, slotGenerations[*slot]) : FTrackedActorHandle();
+}
+
+AActor* FTrackedActorSet::FindDuplicate(AActor* actor) const
+{
+	const int32* slot = actorSlots.Find(actor);
+	return slot ? duplicates[slotIndices[*slot]] : nullptr;
+}
+
+int32 FTrackedActorSet::GetIndex(const FTrackedActorHandle& handle) const
+{
+	if (!slotIndices.IsValidIndex(handle.slot) || slotGenerations[handle.slot] != handle.generation) return INDEX_NONE;
+	return slotIndices[handle.slot];
+}
+
+FTrackedActorHandle FTrackedActorSet::GetHandle(int32 index) const
+{
+	int32 slot = denseSlots[index];
+	return FTrackedActorHandle(slot, slotGenerations[slot]);
+}
+
+int32 FDuplicateInstancer::AddInstance(const FTransform& transform)
+{
+	int32 instance;
+	if (freeInstances.Num() > 0)
+	{
+		instance = freeInstances.Pop(false);
+		transforms[instance] = transform;
+		hidden[instance] = false;
+	}
+	else
+	{
+		instance = transforms.Add(transform);
+		hidden.Add(false);
+		if (component) component->AddInstanceWorldSpace(transform);
+	}
+	dirty = true;
+	return instance;
+}
+
+void FDuplicateInstancer::RemoveInstance(int32 instance)
+{
+	if (!hidden.IsValidIndex(instance)) return;
+	hidden[instance] = true;
+	freeInstances.Add(instance);
+	dirty = true;
+}
+
+void FDuplicateInstancer::SetInstanceTransform(int32 instance, const FTransform& transform)
+{
+	if (!transforms.IsValidIndex(instance)) return;
+	transforms[instance] = transform;
+	dirty = true;
+}
+
+void FDuplicateInstancer::SetInstanceHidden(int32 instance, bool hide)
+{
+	if (!hidden.IsValidIndex(instance) || hidden[instance] == hide) return;
+	hidden[instance] = hide;
+	dirty = true;
+}
+
+void FDuplicateInstancer::Flush()
+{
+	if (!dirty || !component) return;
+	dirty = false;
+
+	// Hidden instances are collapsed to nothing.
+	TArray<FTransform> renderTransforms = transforms;
+	for (int i = 0; i < renderTransforms.Num(); i++)
+	{
+		if (hidden[i]) renderTransforms[i].SetScale3D(FVector::ZeroVector);
+	}
+	component->BatchUpdateInstancesTransforms(0, renderTransforms, true, true, false);
+}
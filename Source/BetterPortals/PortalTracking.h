@@ -0,0 +1,253 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+#include "PortalTracking.generated.h"
+
+/* Handle to an actor tracked by a portal. Stays valid until that actor is removed even as other actors are added and removed.
+ * NOTE: The generation changes each time a slot is reused so a handle to a removed actor never finds the actor that replaced it. */
+struct FTrackedActorHandle
+{
+	int32 slot; /* Slot in the tracked actor set, INDEX_NONE if unset. */
+	uint32 generation; /* Generation of the slot when the handle was made. */
+
+	/* Default Constructor. */
+	FTrackedActorHandle()
+	{
+		slot = INDEX_NONE;
+		generation = 0;
+	}
+
+	/* Main Constructor. */
+	FTrackedActorHandle(int32 trackedSlot, uint32 slotGeneration)
+	{
+		slot = trackedSlot;
+		generation = slotGeneration;
+	}
+
+	/* Has the handle been set. NOTE: Doesn't mean the actor is still tracked, see FTrackedActorSet::GetIndex. */
+	FORCEINLINE bool IsSet() const { return slot != INDEX_NONE; }
+};
+
+/* The actors tracked by a portal stored as separate dense arrays so the per frame update is a linear scan with no hashing.
+ * Each actor is addressed by a generational handle, the dense index of an actor changes when another actor is removed.
+ * NOTE: Removing swaps the last actor into the removed actors index. */
+USTRUCT()
+struct FTrackedActorSet
+{
+	GENERATED_BODY()
+
+public:
+
+	/* The tracked actors. */
+	UPROPERTY()
+	TArray<AActor*> actors;
+
+	/* The component tracked for each actor, its root component. */
+	UPROPERTY()
+	TArray<USceneComponent*> components;
+
+	/* The duplicate of each actor at the target portal, nullptr if it doesn't have one. */
+	UPROPERTY()
+	TArray<AActor*> duplicates;
+
+	/* The location of each tracked component last frame. */
+	TArray<FVector> lastOrigins;
+
+	/* The duplicate instancer and instance of each actor when shown as an instance instead of a duplicate actor, INDEX_NONE if not. */
+	TArray<int32> instancers;
+	TArray<int32> instances;
+
+	/* The substep body of each actor when its crossings are tested in physics substeps this frame, INDEX_NONE if not. */
+	TArray<int32> substepIndices;
+
+private:
+
+	TArray<int32> denseSlots; /* Slot of each dense index. */
+	TArray<int32> slotIndices; /* Dense index of each slot, INDEX_NONE if the slot is free. */
+	TArray<uint32> slotGenerations; /* Current generation of each slot. */
+	TArray<int32> freeSlots; /* Slots free to be reused. */
+	TMap<AActor*, int32> actorSlots; /* Slot of each tracked actor. */
+	TMap<AActor*, int32> duplicateSlots; /* Slot of each duplicates tracked actor. */
+
+public:
+
+	/* Start tracking an actor. Returns the existing handle if the actor is already tracked. */
+	FTrackedActorHandle Add(AActor* actor, USceneComponent* component, const FVector& origin);
+
+	/* Stop tracking an actor. Returns false if the handle is stale. */
+	bool Remove(const FTrackedActorHandle& handle);
+
+	/* Set or clear the duplicate of a tracked actor. */
+	void SetDuplicate(const FTrackedActorHandle& handle, AActor* duplicate);
+
+	/* Set or clear the duplicate instance of a tracked actor, INDEX_NONE clears it. */
+	void SetInstance(const FTrackedActorHandle& handle, int32 instancer, int32 instance);
+
+	/* Returns the handle of a tracked actor, unset if it isn't tracked. */
+	FTrackedActorHandle Find(AActor* actor) const;
+
+	/* Returns the handle of the actor a duplicate was made from, unset if it isn't a duplicate. */
+	FTrackedActorHandle FindByDuplicate(AActor* duplicate) const;
+
+	/* Returns the duplicate of a tracked actor, nullptr if it isn't tracked or has no duplicate. */
+	AActor* FindDuplicate(AActor* actor) const;
+
+	/* Returns the current dense index of a handle, INDEX_NONE if the actor is no longer tracked. */
+	int32 GetIndex(const FTrackedActorHandle& handle) const;
+
+	/* Returns the handle of the actor at a dense index. */
+	FTrackedActorHandle GetHandle(int32 index) const;
+
+	/* Is the actor tracked. */
+	FORCEINLINE bool Contains(AActor* actor) const { return actorSlots.Contains(actor); }
+
+	/* Number of tracked actors. */
+	FORCEINLINE int32 Num() const { return actors.Num(); }
+};
+
+/* A portals volumes in the portal managers broadphase, built once a frame. NOTE: The transforms are at the center of each box without scale. */
+struct FPortalBroadphaseProxy
+{
+	FBox bounds; /* World bounds of both boxes, tested before either oriented box. */
+	FTransform boxTransform; /* The portal box, tracks actors inside it. */
+	FVector boxExtent; /* Scaled extent of the portal box. */
+	FCollisionResponseContainer boxResponses; /* The portal boxes response to each channel, bodies whose object type it ignores aren't tracked. */
+	FTransform meshTransform; /* The portal meshes bounds, shows duplicates of actors touching it. */
+	FVector meshExtent; /* Scaled extent of the portal meshes bounds. */
+	FTransform boxComponentTransform; /* The portal boxes transform the proxy was built from. */
+	FTransform meshComponentTransform; /* The portal meshes transform the proxy was built from. */
+};
+
+/* A physics simulating body tested against every portal in the portal managers broadphase. */
+struct FBroadphaseBody
+{
+	AActor* actor; /* The bodies actor. */
+	ECollisionChannel objectType; /* The bodies collision object type. */
+	FVector lastOrigin; /* Where the body was last frame from its velocity. */
+	FBox bounds; /* World bounds of the body now. */
+	FBox sweptBounds; /* World bounds of the body swept from last frame so it's found even if it passed through a portal box within a frame. */
+	TArray<int32, TInlineAllocator<2>> portalBoxes; /* Each portal whose box the body overlaps. */
+	TArray<int32, TInlineAllocator<2>> portalMeshes; /* Each portal whose mesh the body overlaps. */
+};
+
+/* The actors overlapping a portals box and mesh this frame found by the portal managers broadphase. */
+struct FPortalOverlaps
+{
+	TArray<AActor*, TInlineAllocator<8>> boxActors; /* Actors overlapping the portal box. */
+	TArray<FVector, TInlineAllocator<8>> boxOrigins; /* Where each actor overlapping the portal box was last frame. */
+	TArray<AActor*, TInlineAllocator<8>> meshActors; /* Actors overlapping the portal mesh. */
+
+	/* Empty the overlaps keeping their memory. */
+	void Reset()
+	{
+		boxActors.Reset();
+		boxOrigins.Reset();
+		meshActors.Reset();
+	}
+};
+
+/* A simulating tracked body tested for crossing its portal in every physics substep.
+ * NOTE: Only written by the substep callback while physics is simulating, then read by the portals gather in the portal managers physics tick. */
+struct FSubstepBody
+{
+	FTrackedActorHandle handle; /* The tracked actor of the body. */
+	FVector lastOrigin; /* Location of the body at the last substep. */
+	FVector boxExtent; /* Extent of the bodies bounds when queued. */
+	float elapsedTime; /* Time simulated since the body was queued. */
+	float lastDeltaTime; /* Length of the last substep, the motion since lastOrigin was integrated over it. */
+	float crossedTime; /* Time since the body was queued that it crossed the portal, negative if it hasn't crossed. */
+
+	/* Default Constructor. */
+	FSubstepBody()
+	{
+		lastOrigin = FVector::ZeroVector;
+		boxExtent = FVector::ZeroVector;
+		elapsedTime = 0.0f;
+		lastDeltaTime = 0.0f;
+		crossedTime = -1.0f;
+	}
+};
+
+/* Instances of one mesh and material combination standing in for duplicate actors at a portal, drawn in one draw call.
+ * NOTE: Hidden and free instances are scaled to zero as instanced meshes have no per-instance visibility, so they cast no shadows while hidden. */
+USTRUCT()
+struct FDuplicateInstancer
+{
+	GENERATED_BODY()
+
+public:
+
+	/* The instanced mesh drawing the duplicates. */
+	UPROPERTY()
+	class UInstancedStaticMeshComponent* component;
+
+	TArray<FTransform> transforms; /* World transform of each instance. */
+	TArray<bool> hidden; /* Is each instance hidden from view. */
+	TArray<int32> freeInstances; /* Instances free to be reused. */
+	bool dirty; /* Have any instances changed since the last flush. */
+
+	/* Default Constructor. */
+	FDuplicateInstancer()
+	{
+		component = nullptr;
+		dirty = false;
+	}
+
+	/* Add a visible instance at a world transform, reusing a free instance if there is one. Returns the instance. */
+	int32 AddInstance(const FTransform& transform);
+
+	/* Hide an instance and free it for reuse. */
+	void RemoveInstance(int32 instance);
+
+	/* Move an instance. */
+	void SetInstanceTransform(int32 instance, const FTransform& transform);
+
+	/* Show or hide an instance. */
+	void SetInstanceHidden(int32 instance, bool hide);
+
+	/* Send every instance transform to the component in one batch if any have changed. */
+	void Flush();
+};
+
+/* A range of a portals tracked actors gathered together.
+ * NOTE: Portals with many tracked actors are split into several so they are spread across threads. */
+struct FTrackedActorsChunk
+{
+	class APortal* portal; /* The portal the tracked actors belong to. */
+	int32 first; /* Index of the first tracked actor. */
+	int32 num; /* Number of tracked actors. */
+};
+
+/* The tracked actors of a portal that need their duplicates moving or teleporting this frame.
+ * NOTE: Found by APortal::GatherTrackedActors which only reads so portals can be gathered in parallel, then applied on the game thread. */
+struct FTrackedActorsUpdate
+{
+	TArray<AActor*, TInlineAllocator<16>> duplicates; /* Duplicates to move. */
+	TArray<FVector, TInlineAllocator<16>> duplicateLocs; /* Location of each duplicate at the target portal. */
+	TArray<FQuat, TInlineAllocator<16>> duplicateRots; /* Rotation of each duplicate at the target portal. */
+	TArray<FIntPoint, TInlineAllocator<16>> instances; /* Instancer in X and instance in Y of each duplicate instance to move. */
+	TArray<FVector, TInlineAllocator<16>> instanceLocs; /* Location of each duplicate instance at the target portal. */
+	TArray<FQuat, TInlineAllocator<16>> instanceRots; /* Rotation of each duplicate instance at the target portal. */
+	TArray<FVector, TInlineAllocator<16>> instanceScales; /* Scale of each duplicate instance. */
+	TArray<FTrackedActorHandle, TInlineAllocator<16>> crossedActors; /* Tracked actors whose origin passed through the portal. */
+	TArray<float, TInlineAllocator<16>> crossedTimes; /* Time of impact through the frame of each crossed actor from 0 to 1. */
+	TArray<bool, TInlineAllocator<16>> crossedInSubstep; /* Was each crossed actor already teleported in a physics substep. */
+	TArray<TPair<FTrackedActorHandle, FVector>, TInlineAllocator<16>> trackedOrigins; /* New origin of each tracked actor that hasn't crossed. */
+
+	/* Empty the update keeping its memory. */
+	void Reset()
+	{
+		duplicates.Reset();
+		duplicateLocs.Reset();
+		duplicateRots.Reset();
+		instances.Reset();
+		instanceLocs.Reset();
+		instanceRots.Reset();
+		instanceScales.Reset();
+		crossedActors.Reset();
+		crossedTimes.Reset();
+		crossedInSubstep.Reset();
+		trackedOrigins.Reset();
+	}
+};
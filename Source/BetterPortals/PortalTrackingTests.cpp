@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/Package.h"
+#include "GameFramework/Actor.h"
+#include "PortalTracking.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace PortalTrackingTests
+{
+	/* Actors to track outside of any world. NOTE: The set never dereferences them so they don't need spawning. */
+	void MakeTestActors(AActor** outActors, int32 num)
+	{
+		for (int32 i = 0; i < num; i++) outActors[i] = NewObject<AActor>(GetTransientPackage());
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrackedActorSetHandleTest, "BetterPortals.PortalTracking.TrackedActorSetHandles",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrackedActorSetHandleTest::RunTest(const FString& Parameters)
+{
+	AActor* actors[2];
+	PortalTrackingTests::MakeTestActors(actors, 2);
+	FTrackedActorSet set;
+
+	// Adding an actor again returns its existing handle.
+	FTrackedActorHandle first = set.Add(actors[0], nullptr, FVector(1.0f, 0.0f, 0.0f));
+	TestTrue(TEXT("Added actor has a set handle"), first.IsSet());
+	FTrackedActorHandle again = set.Add(actors[0], nullptr, FVector::ZeroVector);
+	TestTrue(TEXT("Adding again returns the same slot"), again.slot == first.slot && again.generation == first.generation);
+	TestEqual(TEXT("Adding again doesn't add another actor"), set.Num(), 1);
+
+	// A removed actors handle goes stale and can't be removed twice.
+	TestTrue(TEXT("Actor is removed"), set.Remove(first));
+	TestFalse(TEXT("Removed actor isn't tracked"), set.Contains(actors[0]));
+	TestEqual(TEXT("Stale handle has no index"), set.GetIndex(first), (int32)INDEX_NONE);
+	TestFalse(TEXT("Stale handle can't be removed again"), set.Remove(first));
+
+	// The next actor reuses the slot with a new generation so the stale handle doesn't find it.
+	FTrackedActorHandle second = set.Add(actors[1], nullptr, FVector::ZeroVector);
+	TestEqual(TEXT("Freed slot is reused"), second.slot, first.slot);
+	TestTrue(TEXT("Reused slot has a new generation"), second.generation != first.generation);
+	TestEqual(TEXT("Stale handle doesn't find the new actor"), set.GetIndex(first), (int32)INDEX_NONE);
+	TestFalse(TEXT("Stale handle can't remove the new actor"), set.Remove(first));
+	TestTrue(TEXT("New actor is still tracked"), set.Contains(actors[1]));
+
+	// Re-adding the removed actor gets a fresh handle.
+	FTrackedActorHandle readded = set.Add(actors[0], nullptr, FVector(2.0f, 0.0f, 0.0f));
+	TestTrue(TEXT("Re-added actor has a new handle"), readded.slot != first.slot || readded.generation != first.generation);
+	TestTrue(TEXT("Re-added actor is found by its new handle"), set.actors[set.GetIndex(readded)] == actors[0]);
+	TestEqual(TEXT("Re-added actor has its new origin"), set.lastOrigins[set.GetIndex(readded)], FVector(2.0f, 0.0f, 0.0f));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrackedActorSetRemoveTest, "BetterPortals.PortalTracking.TrackedActorSetRemove",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrackedActorSetRemoveTest::RunTest(const FString& Parameters)
+{
+	AActor* actors[4];
+	PortalTrackingTests::MakeTestActors(actors, 4);
+	FTrackedActorSet set;
+	FTrackedActorHandle handles[4];
+	for (int32 i = 0; i < 4; i++) handles[i] = set.Add(actors[i], nullptr, FVector(i, 0.0f, 0.0f));
+
+	// Removing the last actor leaves the others where they are.
+	TestTrue(TEXT("Last actor is removed"), set.Remove(handles[3]));
+	TestEqual(TEXT("Three actors are left"), set.Num(), 3);
+	for (int32 i = 0; i < 3; i++)
+	{
+		TestEqual(TEXT("Other actors keep their index"), set.GetIndex(handles[i]), i);
+		TestEqual(TEXT("Other actors keep their handle"), set.GetHandle(i).slot, handles[i].slot);
+	}
+
+	// Removing a middle actor moves the last actor into its index and its handle follows it.
+	TestTrue(TEXT("Middle actor is removed"), set.Remove(handles[0]));
+	TestEqual(TEXT("Two actors are left"), set.Num(), 2);
+	int32 movedIndex = set.GetIndex(handles[2]);
+	TestEqual(TEXT("Last actor is moved into the removed index"), movedIndex, 0);
+	TestTrue(TEXT("Moved actor is found by its handle"), set.actors[movedIndex] == actors[2]);
+	TestEqual(TEXT("Moved actor keeps its origin"), set.lastOrigins[movedIndex], FVector(2.0f, 0.0f, 0.0f));
+	TestEqual(TEXT("Moved index returns the moved actors handle"), set.GetHandle(movedIndex).slot, handles[2].slot);
+	TestEqual(TEXT("Untouched actor keeps its index"), set.GetIndex(handles[1]), 1);
+	TestEqual(TEXT("Moved actor is found by its actor"), set.GetIndex(set.Find(actors[2])), movedIndex);
+
+	// Removing the rest empties the set.
+	TestTrue(TEXT("Moved actor is removed"), set.Remove(handles[2]));
+	TestTrue(TEXT("Untouched actor is removed"), set.Remove(handles[1]));
+	TestEqual(TEXT("Set is empty"), set.Num(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrackedActorSetDuplicateTest, "BetterPortals.PortalTracking.TrackedActorSetDuplicates",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrackedActorSetDuplicateTest::RunTest(const FString& Parameters)
+{
+	AActor* actors[3];
+	AActor* duplicates[3];
+	PortalTrackingTests::MakeTestActors(actors, 3);
+	PortalTrackingTests::MakeTestActors(duplicates, 3);
+	FTrackedActorSet set;
+	FTrackedActorHandle handles[3];
+	for (int32 i = 0; i < 3; i++)
+	{
+		handles[i] = set.Add(actors[i], nullptr, FVector::ZeroVector);
+		set.SetDuplicate(handles[i], duplicates[i]);
+	}
+
+	// Removing the first actor swaps the last into its index, the duplicates must still match their actors.
+	set.Remove(handles[0]);
+	TestNull(TEXT("Removed actor has no duplicate"), set.FindDuplicate(actors[0]));
+	TestFalse(TEXT("Removed actors duplicate isn't found"), set.FindByDuplicate(duplicates[0]).IsSet());
+	TestTrue(TEXT("Swapped actor keeps its duplicate"), set.FindDuplicate(actors[2]) == duplicates[2]);
+	TestTrue(TEXT("Untouched actor keeps its duplicate"), set.FindDuplicate(actors[1]) == duplicates[1]);
+	TestEqual(TEXT("Swapped actors duplicate finds it"), set.GetIndex(set.FindByDuplicate(duplicates[2])), set.GetIndex(handles[2]));
+
+	// Clearing a duplicate after the swap only clears that actors duplicate.
+	set.SetDuplicate(handles[2], nullptr);
+	TestNull(TEXT("Cleared duplicate isn't found"), set.FindDuplicate(actors[2]));
+	TestFalse(TEXT("Cleared duplicate doesn't find its actor"), set.FindByDuplicate(duplicates[2]).IsSet());
+	TestTrue(TEXT("Other duplicate is kept"), set.FindDuplicate(actors[1]) == duplicates[1]);
+
+	// Setting a duplicate through a stale handle does nothing.
+	set.SetDuplicate(handles[0], duplicates[0]);
+	TestFalse(TEXT("Stale handle doesn't set a duplicate"), set.FindByDuplicate(duplicates[0]).IsSet());
+	return true;
+}
+
+#endif
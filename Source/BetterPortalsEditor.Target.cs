@@ -9,6 +9,6 @@ public class BetterPortalsEditorTarget : TargetRules
 	{
 		Type = TargetType.Editor;
 
-		ExtraModuleNames.AddRange( new string[] { "BetterPortals" } );
+		ExtraModuleNames.AddRange( new string[] { "BetterPortals", "PortalShaders" } );
 	}
 }
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#include "PortalReprojection.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "GlobalShader.h"
+#include "ShaderParameterUtils.h"
+#include "PipelineStateCache.h"
+#include "CommonRenderResources.h"
+#include "RHIStaticStates.h"
+#include "RenderingThread.h"
+#include "TextureResource.h"
+
+/* Full screen triangle without a vertex buffer. */
+class FPortalReprojectionVS : public FGlobalShader
+{
+	DECLARE_SHADER_TYPE(FPortalReprojectionVS, Global);
+
+public:
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	FPortalReprojectionVS() {}
+	FPortalReprojectionVS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer) {}
+};
+
+/* Warps the source capture to the current view. */
+class FPortalReprojectionPS : public FGlobalShader
+{
+	DECLARE_SHADER_TYPE(FPortalReprojectionPS, Global);
+
+public:
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	FPortalReprojectionPS() {}
+	FPortalReprojectionPS(const ShaderMetaType::CompiledShaderInitializerType& Initializer) : FGlobalShader(Initializer)
+	{
+		sourceTexture.Bind(Initializer.ParameterMap, TEXT("SourceTexture"));
+		sourceSampler.Bind(Initializer.ParameterMap, TEXT("SourceSampler"));
+		reprojectionMatrix.Bind(Initializer.ParameterMap, TEXT("ReprojectionMatrix"));
+		unprojectParameters.Bind(Initializer.ParameterMap, TEXT("UnprojectParameters"));
+		depthParameters.Bind(Initializer.ParameterMap, TEXT("DepthParameters"));
+	}
+
+	void SetParameters(FRHICommandList& RHICmdList, FRHITexture* source, const FMatrix& reprojection, const FLinearColor& unproject,
+		const FLinearColor& depth)
+	{
+		FRHIPixelShader* shaderRHI = GetPixelShader();
+		SetTextureParameter(RHICmdList, shaderRHI, sourceTexture, sourceSampler, TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI(), source);
+		SetShaderValue(RHICmdList, shaderRHI, reprojectionMatrix, reprojection);
+		SetShaderValue(RHICmdList, shaderRHI, unprojectParameters, unproject);
+		SetShaderValue(RHICmdList, shaderRHI, depthParameters, depth);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool outdated = FGlobalShader::Serialize(Ar);
+		Ar << sourceTexture << sourceSampler << reprojectionMatrix << unprojectParameters << depthParameters;
+		return outdated;
+	}
+
+private:
+
+	FShaderResourceParameter sourceTexture;
+	FShaderResourceParameter sourceSampler;
+	FShaderParameter reprojectionMatrix;
+	FShaderParameter unprojectParameters;
+	FShaderParameter depthParameters;
+};
+
+IMPLEMENT_GLOBAL_SHADER(FPortalReprojectionVS, "/BetterPortals/PortalReprojection.usf", "MainVS", SF_Vertex);
+IMPLEMENT_GLOBAL_SHADER(FPortalReprojectionPS, "/BetterPortals/PortalReprojection.usf", "MainPS", SF_Pixel);
+
+bool FPortalReprojection::IsSupported(ERHIFeatureLevel::Type featureLevel)
+{
+	return featureLevel >= ERHIFeatureLevel::SM5;
+}
+
+void FPortalReprojection::Reproject(UTextureRenderTarget2D* source, UTextureRenderTarget2D* destination, const FMatrix& reprojection,
+	const FLinearColor& unproject, const FLinearColor& depth, ERHIFeatureLevel::Type featureLevel)
+{
+	if (!source || !destination || !IsSupported(featureLevel)) return;
+	FTextureRenderTargetResource* sourceResource = source->GameThread_GetRenderTargetResource();
+	FTextureRenderTargetResource* destinationResource = destination->GameThread_GetRenderTargetResource();
+	if (!sourceResource || !destinationResource) return;
+
+	ENQUEUE_RENDER_COMMAND(PortalReprojection)([sourceResource, destinationResource, reprojection, unproject, depth, featureLevel](FRHICommandListImmediate& RHICmdList)
+	{
+		FRHITexture2D* sourceTexture = sourceResource->GetRenderTargetTexture();
+		FRHITexture2D* destinationTexture = destinationResource->GetRenderTargetTexture();
+		if (!sourceTexture || !destinationTexture) return;
+
+		// Every destination pixel is written so nothing needs loading.
+		FRHIRenderPassInfo passInfo(destinationTexture, ERenderTargetActions::DontLoad_Store);
+		RHICmdList.BeginRenderPass(passInfo, TEXT("PortalReprojection"));
+		FIntPoint size = destinationTexture->GetSizeXY();
+		RHICmdList.SetViewport(0.0f, 0.0f, 0.0f, size.X, size.Y, 1.0f);
+
+		TShaderMap<FGlobalShaderType>* shaderMap = GetGlobalShaderMap(featureLevel);
+		TShaderMapRef<FPortalReprojectionVS> vertexShader(shaderMap);
+		TShaderMapRef<FPortalReprojectionPS> pixelShader(shaderMap);
+		FGraphicsPipelineStateInitializer graphicsPSOInit;
+		RHICmdList.ApplyCachedRenderTargets(graphicsPSOInit);
+		graphicsPSOInit.BlendState = TStaticBlendState<>::GetRHI();
+		graphicsPSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
+		graphicsPSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+		graphicsPSOInit.BoundShaderState.VertexDeclarationRHI = GEmptyVertexDeclaration.VertexDeclarationRHI;
+		graphicsPSOInit.BoundShaderState.VertexShaderRHI = GETSAFERHISHADER_VERTEX(*vertexShader);
+		graphicsPSOInit.BoundShaderState.PixelShaderRHI = GETSAFERHISHADER_PIXEL(*pixelShader);
+		graphicsPSOInit.PrimitiveType = PT_TriangleList;
+		SetGraphicsPipelineState(RHICmdList, graphicsPSOInit);
+		pixelShader->SetParameters(RHICmdList, sourceTexture, reprojection, unproject, depth);
+		RHICmdList.DrawPrimitive(0, 1, 1);
+		RHICmdList.EndRenderPass();
+
+		// Make the result readable by the portal material.
+		RHICmdList.CopyToResolveTarget(destinationTexture, destinationTexture, FResolveParams());
+	});
+}
@@ -0,0 +1,13 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PortalShaders.h"
+#include "Misc/Paths.h"
+#include "ShaderCore.h"
+
+void FPortalShadersModule::StartupModule()
+{
+	// Shaders in the projects Shaders directory are found under /BetterPortals.
+	AddShaderSourceDirectoryMapping(TEXT("/BetterPortals"), FPaths::Combine(FPaths::ProjectDir(), TEXT("Shaders")));
+}
+
+IMPLEMENT_MODULE(FPortalShadersModule, PortalShaders);
@@ -0,0 +1,21 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+#pragma once
+#include "CoreMinimal.h"
+#include "RHIDefinitions.h"
+
+/* Warps portal captures to the current view on the frames they aren't captured using the scene depth stored in the captures alpha.
+ * NOTE: A full screen pixel pass on the render thread from the capture into a second render target of the same size, as a render target
+ *       can't be read and written in the same pass. The shader is in Shaders/PortalReprojection.usf mapped to /BetterPortals. */
+struct PORTALSHADERS_API FPortalReprojection
+{
+	/* Can the reprojection pass run at the given feature level. */
+	static bool IsSupported(ERHIFeatureLevel::Type featureLevel);
+
+	/* Queue a warp of the source capture into the destination render target on the render thread.
+	 * For each destination pixel the source UV is found by stepping a guess by the screen space error of where its stored depth reprojects to.
+	 * NOTE: The reprojection matrix goes from the captures view space to the current clip space, see FPortalMath::MakeReprojectionMatrix.
+	 *       Unproject parameters are from FPortalMath::GetUnprojectParameters for the captures projection and depth parameters are from
+	 *       FPortalMath::GetDepthParameters for the projection it was captured with, including its oblique near plane. */
+	static void Reproject(class UTextureRenderTarget2D* source, class UTextureRenderTarget2D* destination, const FMatrix& reprojection,
+		const FLinearColor& unproject, const FLinearColor& depth, ERHIFeatureLevel::Type featureLevel);
+};
@@ -0,0 +1,17 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Modules/ModuleManager.h"
+
+/* The portal global shaders module. Maps the projects shader directory so the portal global shaders can be found.
+ * NOTE: Loads in the PostConfigInit phase so the global shaders are registered before the global shader map is compiled,
+ *       kept apart from the game module so its classes still load in the default phase. */
+class FPortalShadersModule : public IModuleInterface
+{
+public:
+
+	/* Module loaded. */
+	virtual void StartupModule() override;
+};